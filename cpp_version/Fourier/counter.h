@@ -22,7 +22,7 @@ namespace Fourier {
         float* output; // temp array for transform
         heap<record, DEPTH> history;
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
 
         void transform(const uint16_t start) {
             pffft_transform(setup, recent, output, nullptr, PFFFT_FORWARD);
@@ -72,7 +72,7 @@ namespace Fourier {
             return *this;
         }
 
-        void reset() override {
+        void reset() {
             start_time = 0;
             window_n = 0;
             memset(recent, 0, WINDOW * 4);
@@ -80,7 +80,7 @@ namespace Fourier {
             cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
@@ -95,29 +95,36 @@ namespace Fourier {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
             transform(window_n * WINDOW);
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
+        SERIES rebuild(HASH) const {
             assert(!empty());
             if(!cache.empty())
                 return cache;
 
             cache.resize(MAX_LENGTH);
-            static auto* origin = static_cast<float *>(pffft_aligned_malloc(MAX_LENGTH * 4));
-            static auto* buffer = static_cast<float *>(pffft_aligned_malloc(MAX_LENGTH * 4));
-            static auto* worker = static_cast<float *>(pffft_aligned_malloc(WINDOW * 4));
+            // scratch buffers are per thread, so counters can be rebuilt concurrently
+            // and are given back when the thread exits
+            using scratch = unique_ptr<float[], decltype(&pffft_aligned_free)>;
+            auto allocate = [](size_t n) {
+                return scratch(static_cast<float *>(pffft_aligned_malloc(n * 4)), pffft_aligned_free);
+            };
+            thread_local scratch origin_buf = allocate(MAX_LENGTH);
+            thread_local scratch buffer_buf = allocate(MAX_LENGTH);
+            thread_local scratch worker_buf = allocate(WINDOW);
+            float *origin = origin_buf.get(), *buffer = buffer_buf.get(), *worker = worker_buf.get();
 
             memset(origin, 0, MAX_LENGTH * 4);
 
@@ -140,12 +147,21 @@ namespace Fourier {
             return cache;
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             result += history.serialize();
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            history.serialize(out);
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            history.deserialize(in);
+        }
     };
 
     PFFFT_Setup* counter::setup = pffft_new_setup(WINDOW, PFFFT_REAL);
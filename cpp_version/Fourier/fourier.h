@@ -6,7 +6,8 @@
 
 using namespace std;
 
-class fourier : public basic_scheme<Fourier::table> {
+template<uint32_t W = FULL_WIDTH>
+class fourier : public basic_scheme<Fourier::table<W>> {
 
 };
 
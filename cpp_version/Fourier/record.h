@@ -21,6 +21,14 @@ namespace Fourier {
             result += sizeof(data);
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(pos);
+            out.put(data);
+        }
+        void deserialize(bit_reader& in) {
+            pos = in.get<uint16_t>();
+            data = in.get<float>();
+        }
 
         friend constexpr partial_ordering operator<=>(const record& lhs, const record& rhs);
     };
@@ -8,7 +8,8 @@ using namespace std;
 
 namespace Fourier {
 
-class table : public basic_table<counter, ROUND(FULL_WIDTH * (FULL_DEPTH * 4 + 4), (((FULL_DEPTH * 4) / 6) * 6 + 4 * SAMPLE_RATE * 2 + 10))> {
+    template<uint32_t W = FULL_WIDTH>
+    class table : public basic_table<table<W>, counter, ROUND(W * (FULL_DEPTH * 4 + 4), (((FULL_DEPTH * 4) / 6) * 6 + 4 * SAMPLE_RATE * 2 + 10))> {
 
     };
 
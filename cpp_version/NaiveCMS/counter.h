@@ -13,12 +13,12 @@ namespace NaiveCMS {
         TIME start_time{};
         array<DATA, DEPTH> history{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             history.fill(0);
         }
 
-        bool count(TIME t, HASH h, DATA c) override {
+        bool count(TIME t, HASH h, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
@@ -29,15 +29,15 @@ namespace NaiveCMS {
             return false;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH h) const override { // TODO: fix this
+        SERIES rebuild(HASH h) const { // TODO: fix this
             cerr << "Should not reach here." << endl;
             assert(false);
             return {};
@@ -47,7 +47,7 @@ namespace NaiveCMS {
             return history[h % DEPTH];
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // history has fixed length
@@ -55,6 +55,17 @@ namespace NaiveCMS {
                 result += sizeof(d);
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            for(auto& d : history)
+                out.put(d);
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            for(auto& d : history)
+                d = in.get<DATA>();
+        }
     };
 
 } // NaiveCMS
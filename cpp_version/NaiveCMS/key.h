@@ -21,6 +21,10 @@ namespace NaiveCMS {
             simple_hash(this, 17, seed, &hash_value);
             return hash_value;
         }
+
+        uint64_t digest() const {
+            return flow.digest(fmix64(time + five_tuple::DIGEST_SEED));
+        }
     };
 
 } // NaiveCMS
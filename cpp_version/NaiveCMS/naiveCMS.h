@@ -6,7 +6,8 @@
 
 using namespace std;
 
-class naiveCMS : public basic_scheme<NaiveCMS::table> {
+template<uint32_t W = FULL_WIDTH>
+class naiveCMS : public basic_scheme<NaiveCMS::table<W>> {
 
 };
 
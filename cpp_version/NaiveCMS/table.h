@@ -9,62 +9,80 @@ using namespace std;
 
 namespace NaiveCMS {
 
-    class table : public basic_table<counter> {
+    template<uint32_t W = FULL_WIDTH>
+    class table : public basic_table<table<W>, counter, W> {
+        friend class basic_table<table, counter, W>;
     protected:
         TIME start_time{};
         TIME last_time{};
 
-        void derived_reset() override {
+        void derived_reset() {
             start_time = 0;
             last_time = 0;
         }
+        // counters are indexed by flow and time together
+        static void digest_packets(span<const PACKET> batch, uint64_t* out) {
+            digest_batch<true>(batch, out);
+        }
     public:
-        bool count(const five_tuple& f, TIME t, DATA c) override {
+        bool count(const five_tuple& f, TIME t, DATA c) {
+            return count(key{f, t}.digest(), t, c);
+        }
+        bool count(uint64_t digest, TIME t, DATA c) {
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
             }
 
             last_time = t;
-            key k{f, t};
-            for(int row = 0; row < HEIGHT; row++) {
-                HASH h = k.hash(seeds[row]);
-                HASH rem = h % WIDTH;
-                HASH quo = h / WIDTH;
-                bool result = counters[row][rem].count(t, quo, c);
+            for(int row = 0; row < table::HEIGHT; row++) {
+                auto [rem, quo] = table::locate(digest, row);
+                bool result = table::counters[row][rem].count(t, quo, c);
                 if(result) {
-                    history[row][rem].push_back(counters[row][rem]);
-                    counters[row][rem].reset();
-                    counters[row][rem].count(t, quo, c);
+                    table::history[row][rem].push_back(table::counters[row][rem]);
+                    table::counters[row][rem].reset();
+                    table::counters[row][rem].count(t, quo, c);
                 }
             }
 
             return true;
         }
 
-        STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const {
-            vector<array<DATA, HEIGHT>> merger(last - start + 1);
-            STREAM_QUEUE result(last - start + 1);
-
-            for(TIME t = start; t <= last; t++) {
-                key k{f, t};
-                auto& slot = merger[t - start];
-                for(int row = 0; row < HEIGHT; row++) {
-                    HASH h = k.hash(seeds[row]);
-                    HASH rem = h % WIDTH;
-                    HASH quo = h / WIDTH;
-                    auto& hc = history[row][rem];
-                    auto c = first_history(hc, t);
-                    if(c != hc.end() && t >= c->start())
-                        slot[row] = c->query(quo);
-                    else
-                        slot[row] = 0;
-                }
-
-                DATA min = select_val(slot);
-                assert(min >= 0);
-                result[t - start] = make_pair(t, min);
+        // the count of f in time slot t
+        DATA point(const five_tuple& f, TIME t) const {
+            uint64_t digest = key{f, t}.digest();
+            array<DATA, table::HEIGHT> slot;
+            for(int row = 0; row < table::HEIGHT; row++) {
+                auto [rem, quo] = table::locate(digest, row);
+                auto& hc = table::history[row][rem];
+                auto c = table::first_history(hc, t);
+                if(c != hc.end() && t >= c->start())
+                    slot[row] = c->query(quo);
+                else
+                    slot[row] = 0;
             }
 
+            DATA min = this->select_val(slot);
+            assert(min >= 0);
+            return min;
+        }
+        void rebuild(const five_tuple& f, TIME start, TIME last, span<pair<TIME, DATA>> out) const {
+            for(TIME t = start; t <= last; t++)
+                out[t - start] = make_pair(t, point(f, t));
+        }
+        // every time slot is looked up on its own
+        template<typename F>
+        void query(const five_tuple& f, TIME a, TIME b, F&& out) const {
+            for(TIME t = a; t <= b; t++)
+                out(t, point(f, t));
+        }
+        // counters hold flows per time slot rather than whole flows, so there is nothing to share between them
+        STREAM rebuild_all(const STREAM& dict) const {
+            STREAM result;
+            result.reserve(dict.size(), dict.slots());
+            for(auto [f, q] : dict) {
+                TIME start = q.front().first, last = q.back().first;
+                rebuild(f, start, last, result.allocate(f, last - start + 1));
+            }
             return result;
         }
     };
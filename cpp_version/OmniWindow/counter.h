@@ -14,15 +14,15 @@ namespace OmniWindow {
         TIME start_time{};
         array<DATA, DEPTH + (DEPTH * RATE < MAX_LENGTH ? 1 : 0)> history{};
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             history.fill(0);
             cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
@@ -34,15 +34,15 @@ namespace OmniWindow {
             return false;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
+        SERIES rebuild(HASH) const {
             assert(!empty());
             if(!cache.empty())
                 return cache;
@@ -63,7 +63,7 @@ namespace OmniWindow {
             return cache;
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // history has fixed length
@@ -71,6 +71,17 @@ namespace OmniWindow {
                 result += sizeof(d);
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            for(auto& d : history)
+                out.put(d);
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            for(auto& d : history)
+                d = in.get<DATA>();
+        }
     };
 
 } // OmniWindow
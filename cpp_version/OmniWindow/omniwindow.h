@@ -6,7 +6,8 @@
 
 using namespace std;
 
-class omniwindow : public basic_scheme<OmniWindow::table> {
+template<uint32_t W = FULL_WIDTH>
+class omniwindow : public basic_scheme<OmniWindow::table<W>> {
 
 };
 
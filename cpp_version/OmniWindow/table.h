@@ -8,7 +8,8 @@ using namespace std;
 
 namespace OmniWindow {
 
-    class table : public basic_table<counter> {
+    template<uint32_t W = FULL_WIDTH>
+    class table : public basic_table<table<W>, counter, W> {
 
     };
 
@@ -7,9 +7,9 @@ using namespace std;
 
 namespace PersistAMS {
 
-    class record : public STREAM_QUEUE::value_type {
+    class record : public pair<TIME, DATA> {
     public:
-        using Base = STREAM_QUEUE::value_type;
+        using Base = pair<TIME, DATA>;
         using Base::Base;
 
         size_t serialize() const {
@@ -18,16 +18,27 @@ namespace PersistAMS {
             result += sizeof(Base::second_type);
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(this->first);
+            out.put(this->second);
+        }
+        void deserialize(bit_reader& in) {
+            this->first = in.get<TIME>();
+            this->second = in.get<DATA>();
+        }
     };
 
     class counter : public abstract_counter {
+    public:
+        // rebuild takes the sign of the window from h
+        constexpr static const bool KEYED = true;
     protected:
-        // random generator
+        // random generator, one per counter and seeded by the first packet of the window,
+        // so that counters sample the same whichever thread counts them
         constexpr static const int DELTA = MAX_LENGTH / ROUND(FULL_DEPTH * 4 + 4 - 24, 10);
-        static mt19937 gen;
-        static uniform_int_distribution<> dis;
-        static bool test() {
-            return dis(gen) == 1;
+        minstd_rand gen{};
+        bool test() {
+            return uniform_int_distribution<>(1, DELTA)(gen) == 1;
         }
 
         TIME start_time{};
@@ -35,9 +46,9 @@ namespace PersistAMS {
         DATA value[2]{};
         list<record> history[2]{};
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             last_time[0] = 0;
             last_time[1] = 0;
@@ -48,11 +59,12 @@ namespace PersistAMS {
             cache.clear();
         }
 
-        bool count(TIME t, HASH h, DATA c) override {
+        bool count(TIME t, HASH h, DATA c) {
             HASH sign = h % 2;
             assert(t >= last_time[sign]);
             if(start_time == 0) [[unlikely]] {
                 start_time = last_time[0] = last_time[1] = t;
+                gen.seed(0xAEABDC85u ^ (t * 0x9E3779B1u) ^ h);
             } else if(t - start_time >= MAX_LENGTH) [[unlikely]] {
                 flush();
                 return true;
@@ -67,7 +79,7 @@ namespace PersistAMS {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
             if(test())
@@ -76,15 +88,15 @@ namespace PersistAMS {
                 history[1].emplace_back(last_time[1], value[1]);
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH h) const override {
+        SERIES rebuild(HASH h) const {
             assert(!empty());
             DATA sign = h % 2 ? 1 : -1;
             if(cache.empty()) {
@@ -111,13 +123,15 @@ namespace PersistAMS {
                 }
             }
 
-            STREAM_QUEUE result = cache;
+            // the signed copy is shared by all counters rebuilt on this thread
+            thread_local vector<pair<TIME, DATA>> result;
+            result = cache;
             for(auto& p : result)
                 p.second = sign * p.second >= 0 ? sign * p.second : 0;
             return result;
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // counter for histories
@@ -128,11 +142,25 @@ namespace PersistAMS {
                 result += r.serialize();
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            out.put(uint16_t(history[0].size()));
+            out.put(uint16_t(history[1].size()));
+            for(auto& r : history[0])
+                r.serialize(out);
+            for(auto& r : history[1])
+                r.serialize(out);
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            size_t n[2] = {in.get<uint16_t>(), in.get<uint16_t>()};
+            for(int k = 0; k < 2; k++)
+                for(size_t i = 0; i < n[k]; i++)
+                    history[k].emplace_back().deserialize(in);
+        }
     };
 
-    mt19937 counter::gen(0xAEABDC85);
-    uniform_int_distribution<> counter::dis(1, DELTA);
-
 } // PersistAMS
 
 #endif //PERSIST_AMS_COUNTER_H
@@ -6,7 +6,8 @@
 
 using namespace std;
 
-class persistAMS : public basic_scheme<PersistAMS::table> {
+template<uint32_t W = FULL_WIDTH>
+class persistAMS : public basic_scheme<PersistAMS::table<W>> {
 
 };
 
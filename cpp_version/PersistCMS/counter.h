@@ -23,9 +23,9 @@ namespace PersistCMS {
         list<line> history{};
         polygon solver{};
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             last_time = 0;
             value = 0;
@@ -34,7 +34,7 @@ namespace PersistCMS {
             cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        bool count(TIME t, HASH, DATA c) {
             assert(t >= last_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = last_time = t;
@@ -52,7 +52,7 @@ namespace PersistCMS {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
             // the last value will not change by now, feed to solver
@@ -69,15 +69,15 @@ namespace PersistCMS {
             return result >= 0 ? result : 0;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
+        SERIES rebuild(HASH) const {
             assert(!empty());
             if(!cache.empty())
                 return cache;
@@ -100,7 +100,7 @@ namespace PersistCMS {
             return cache;
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             // counter for history
@@ -109,6 +109,19 @@ namespace PersistCMS {
                 result += l.serialize();
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            out.put(uint16_t(history.size()));
+            for(auto& l : history)
+                l.serialize(out);
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            size_t n = in.get<uint16_t>();
+            for(size_t i = 0; i < n; i++)
+                history.emplace_back().deserialize(in);
+        }
     };
 
 } // PersistCMS
@@ -6,7 +6,8 @@
 
 using namespace std;
 
-class persistCMS : public basic_scheme<PersistCMS::table> {
+template<uint32_t W = FULL_WIDTH>
+class persistCMS : public basic_scheme<PersistCMS::table<W>> {
 
 };
 
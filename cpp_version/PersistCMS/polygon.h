@@ -18,6 +18,14 @@ namespace PersistCMS {
             result += sizeof(this->second);
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(this->first);
+            out.put(this->second);
+        }
+        void deserialize(bit_reader& in) {
+            this->first = in.get<double>();
+            this->second = in.get<double>();
+        }
     };
     class line : public pair<TIME, node> {
     public:
@@ -30,6 +38,14 @@ namespace PersistCMS {
             result += this->second.serialize();
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(this->first);
+            this->second.serialize(out);
+        }
+        void deserialize(bit_reader& in) {
+            this->first = in.get<TIME>();
+            this->second.deserialize(in);
+        }
     };
 
     // polygon represents (m, b) pair of all lines u = mt + b fitting data ranges (t_k, [alpha_k, omega_k]).
@@ -8,10 +8,12 @@ using namespace std;
 
 namespace PersistCMS {
 
-    class table : public basic_table<counter> {
+    template<uint32_t W = FULL_WIDTH>
+    class table : public basic_table<table<W>, counter, W> {
+        friend class basic_table<table, counter, W>;
     protected:
-        DATA select_val(array<DATA, HEIGHT>& vals) const override {
-            return select_median(vals);
+        DATA select_val(array<DATA, table::HEIGHT>& vals) const {
+            return table::select_median(vals);
         }
     };
 
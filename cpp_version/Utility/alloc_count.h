@@ -0,0 +1,9 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <cstddef>
+
+/* heap allocations made by the calling thread; operator new counts them only when COUNT_ALLOCS is defined */
+inline thread_local size_t thread_allocs = 0;
+
+#endif //ALLOC_COUNT_H
@@ -0,0 +1,98 @@
+#ifndef BIT_STREAM_H
+#define BIT_STREAM_H
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+using namespace std;
+
+/* bit-packed encoding of sketch state; fields are appended least significant bit first, without padding,
+ * and whole words are copied in host order, i.e. little-endian */
+class bit_writer {
+protected:
+    vector<uint8_t> bytes;
+    uint64_t pending = 0;
+    unsigned used = 0;
+public:
+    // append the low bits of v
+    void write(uint64_t v, unsigned bits) {
+        assert(bits <= 64);
+        if(bits < 64)
+            v &= (uint64_t(1) << bits) - 1;
+        pending |= v << used;
+        if(used + bits >= 64) {
+            size_t n = bytes.size();
+            bytes.resize(n + 8);
+            memcpy(bytes.data() + n, &pending, 8);
+            pending = used == 0 ? 0 : v >> (64 - used);
+            used = used + bits - 64;
+        } else
+            used += bits;
+    }
+    // append a field with all the bits of its type
+    template<typename T>
+    void put(T v) {
+        if constexpr(is_floating_point_v<T>)
+            write(bit_cast<conditional_t<sizeof(T) == 8, uint64_t, uint32_t>>(v), sizeof(T) * 8);
+        else
+            write(uint64_t(v), sizeof(T) * 8);
+    }
+
+    // bits written so far
+    size_t bits() const {
+        return bytes.size() * 8 + used;
+    }
+    // encoded bytes, the last one padded with zeros
+    span<const uint8_t> data() {
+        for(; used > 0; used = used > 8 ? used - 8 : 0, pending >>= 8)
+            bytes.push_back(pending);
+        pending = 0;
+        return bytes;
+    }
+    void clear() {
+        bytes.clear();
+        pending = 0;
+        used = 0;
+    }
+};
+
+class bit_reader {
+protected:
+    span<const uint8_t> bytes;
+    size_t pos = 0;
+public:
+    explicit bit_reader(span<const uint8_t> b) : bytes(b) {}
+
+    uint64_t read(unsigned bits) {
+        assert(bits <= 64 && pos + bits <= bytes.size() * 8);
+        // one word holds at least 57 bits past any offset
+        if(bits > 56) {
+            uint64_t lo = read(32);
+            return lo | read(bits - 32) << 32;
+        }
+        uint64_t word = 0;
+        size_t byte = pos / 8;
+        memcpy(&word, bytes.data() + byte, min<size_t>(8, bytes.size() - byte));
+        uint64_t result = (word >> (pos % 8)) & ((uint64_t(1) << bits) - 1);
+        pos += bits;
+        return result;
+    }
+    template<typename T>
+    T get() {
+        if constexpr(is_floating_point_v<T>)
+            return bit_cast<T>(conditional_t<sizeof(T) == 8, uint64_t, uint32_t>(read(sizeof(T) * 8)));
+        else
+            return T(read(sizeof(T) * 8));
+    }
+
+    // bits read so far
+    size_t bits() const {
+        return pos;
+    }
+};
+
+#endif //BIT_STREAM_H
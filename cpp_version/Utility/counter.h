@@ -1,29 +1,65 @@
 #ifndef COUNTER_H
 #define COUNTER_H
 
+#include <concepts>
+#include <vector>
+
+#include "bit_stream.h"
 #include "types.h"
 
 using namespace std;
 
+/* counters are stored by value in tables and dispatched statically; every counter provides
+ *   void reset();                   reset all related data structures; act as an empty counter afterward
+ *   bool count(TIME t, HASH h, DATA c);  count individual packet arriving at time t, return true only if full
+ *   void flush();                   finish recording and deal with remaining buffered data
+ *   SERIES rebuild(HASH h) const;   rebuild counters in a period with ascending timestamps;
+ *                                   valid until the next rebuild on this thread or reset
+ *   bool empty() const;             test if the counter is empty
+ *   TIME start() const;             return timestamp of first packet, inclusive
+ *   size_t serialize() const;       serialize the contents in counter
+ *   void serialize(bit_writer& out) const;  write the bytes counted by serialize(), enough to rebuild
+ *   void deserialize(bit_reader& in);       restore a flushed counter written by serialize(out)
+ *   void prefetch() const;          hint the cache lines touched by the next count
+ * a counter may declare sealed_type, a compact form its saved windows are kept in by history,
+ * and KEYED if rebuild depends on h, so that one rebuild does not serve every flow hashed to it;
+ * and the form kept in history may provide scan(h, a, b, out), handing the points rebuild(h) has within [a, b]
+ * to out(t, value) in time order without rebuilding */
 class abstract_counter {
 public:
-    // reset all related data structures; act as an empty counter afterward
-    virtual void reset() = 0;
-    // count individual packet arriving at time t, return true only if full
-    virtual bool count(TIME t, HASH h, DATA c) = 0;
-    // finish recording and deal with remaining buffered data
-    virtual void flush() { };
-    // rebuild counters in a period with timestamps
-    virtual STREAM_QUEUE rebuild(HASH h) const = 0;
-    // test if the counter is empty
-    virtual bool empty() const = 0;
-    // return timestamp of first packet, inclusive
-    virtual TIME start() const = 0;
-    // serialize the contents in counter
-    virtual size_t serialize() const = 0;
+    void flush() { }
+    void prefetch() const {
+        __builtin_prefetch(this, 1);
+    }
 };
 
 template<typename C>
-concept DerivedCounter = std::is_base_of_v<abstract_counter, C>;
+concept DerivedCounter = std::is_base_of_v<abstract_counter, C> &&
+    requires(C c, const C& cc, TIME t, HASH h, DATA d, bit_writer& out, bit_reader& in) {
+        c.reset();
+        { c.count(t, h, d) } -> std::same_as<bool>;
+        c.flush();
+        { cc.rebuild(h) } -> std::convertible_to<SERIES>;
+        { cc.empty() } -> std::same_as<bool>;
+        { cc.start() } -> std::same_as<TIME>;
+        { cc.serialize() } -> std::convertible_to<size_t>;
+        cc.serialize(out);
+        c.deserialize(in);
+        cc.prefetch();
+    };
+
+// whether C declares KEYED
+template<typename C>
+constexpr bool keyed_rebuild = requires { requires C::KEYED; };
+
+// the form saved counters of C are kept in
+template<typename C>
+struct sealed_of {
+    typedef C type;
+};
+template<typename C> requires requires { typename C::sealed_type; }
+struct sealed_of<C> {
+    typedef typename C::sealed_type type;
+};
 
 #endif //COUNTER_H
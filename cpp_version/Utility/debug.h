@@ -5,7 +5,7 @@
 
 #include "five_tuple.h"
 
-/* preprocess */
+/* preprocess; defaults of the runtime options in config.h, see niffler --help */
 // #define SELECT_IN
 // #define SELECT_OUT
 // #define FILTER_LOW 20u
@@ -15,10 +15,42 @@
 //#define META_OUT ("meta_report.csv")
 //#define FILTER_TIME (25308u * TIMESCALE)
 //#define BY_BYTES 1
+// worker threads for trace parsing, 0 for hardware concurrency
+#define PARSE_THREADS 0u
+// feed packets from FILE_IN to sketches in batches instead of loading the whole trace
+//#define STREAM_IN
+// accumulate the ground truth while streaming; otherwise only flow spans are kept and no report is made
+//#define STREAM_TRUTH
+#define BATCH_SIZE 4096u
+// split each wavelet scheme into SHARDS instances of 1/SHARDS the memory, counting on threads of their own
+//#define SHARDED_IN
+#define SHARDS 4u
+// packets queued between the caller and each shard
+#define RING_SIZE 16384u
+// rotate the sketches of a streamed trace every EPOCH_IN time slots, each epoch flushed and rebuilt on its own
+//#define EPOCH_IN (MAX_LENGTH * 4)
+// sketches in rotation per scheme: one counting, the others flushed and rebuilt in the background
+#define EPOCH_BUFFERS 2u
+// saved counters per table cell kept whole, older ones are spilled bit-packed
+#ifndef HISTORY_SLOTS
+#define HISTORY_SLOTS 4u
+#endif
+// time slots of spilled history kept behind the latest spill, 0 to keep all
+#ifndef HISTORY_RETENTION
+#define HISTORY_RETENTION 0u
+#endif
+// time slots of flows rebuilt together by a table, bounding the values held for them before selection
+#define REBUILD_SLOTS (1u << 20)
+// count heap allocations made while schemes count, reported per scheme with the history stores' own
+//#define COUNT_ALLOCS
+// worker threads running schemes side by side, 0 for hardware concurrency
+#define EVAL_THREADS 0u
+// threads rebuilding the flows of one scheme, 0 for hardware concurrency
+#define REBUILD_THREADS 0u
 
 static five_tuple breakpoint(2882);
 
-/* execution */
+/* execution; schemes selected by default */
 #define USE_WAVE_IDEAL methods::WAVE_IDEAL
 #define USE_WAVE_PRACTICAL methods::WAVE_PRACTICAL
 #define USE_OMNIWINDOW methods::OMNIWINDOW
@@ -0,0 +1,83 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <cassert>
+#include <span>
+
+#include "types.h"
+
+#if defined(__AVX512DQ__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// packets whose digests are computed together
+#define DIGEST_BATCH 16u
+
+#if defined(__AVX512DQ__)
+static FORCE_INLINE __m512i fmix64x8(__m512i k) {
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(BIG_CONSTANT(0xff51afd7ed558ccd)));
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(BIG_CONSTANT(0xc4ceb9fe1a85ec53)));
+    return _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+}
+#elif defined(__AVX2__)
+// low 64 bits of a * b in every lane, from 32-bit products
+static FORCE_INLINE __m256i mullo64x4(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+static FORCE_INLINE __m256i fmix64x4(__m256i k) {
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mullo64x4(k, _mm256_set1_epi64x(BIG_CONSTANT(0xff51afd7ed558ccd)));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mullo64x4(k, _mm256_set1_epi64x(BIG_CONSTANT(0xc4ceb9fe1a85ec53)));
+    return _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+}
+#endif
+
+/* digests of up to DIGEST_BATCH packets, equal to five_tuple::digest one by one;
+ * with TIMED the time of each packet is mixed into its seed, as NaiveCMS::key::digest does.
+ * out must hold DIGEST_BATCH digests, those past the batch are unspecified */
+template<bool TIMED = false>
+inline void digest_batch(span<const PACKET> batch, uint64_t* out) {
+    assert(batch.size() <= DIGEST_BATCH);
+    alignas(64) uint64_t ips[DIGEST_BATCH]{}, ports[DIGEST_BATCH]{}, seeds[DIGEST_BATCH]{};
+    for(size_t i = 0; i < batch.size(); i++) {
+        auto& [f, t, c] = batch[i];
+        ips[i] = f.ip_word();
+        ports[i] = f.port_word();
+        seeds[i] = TIMED ? t + five_tuple::DIGEST_SEED : five_tuple::DIGEST_SEED;
+    }
+
+#if defined(__AVX512DQ__)
+    for(size_t i = 0; i < DIGEST_BATCH; i += 8) {
+        __m512i seed = _mm512_load_si512(seeds + i);
+        if constexpr(TIMED)
+            seed = fmix64x8(seed);
+        __m512i port = fmix64x8(_mm512_xor_si512(_mm512_load_si512(ports + i), seed));
+        __m512i ip = _mm512_xor_si512(_mm512_load_si512(ips + i), port);
+        _mm512_storeu_si512(out + i, fmix64x8(ip));
+    }
+#elif defined(__AVX2__)
+    for(size_t i = 0; i < DIGEST_BATCH; i += 4) {
+        __m256i seed = _mm256_load_si256((const __m256i*)(seeds + i));
+        if constexpr(TIMED)
+            seed = fmix64x4(seed);
+        __m256i port = fmix64x4(_mm256_xor_si256(_mm256_load_si256((const __m256i*)(ports + i)), seed));
+        __m256i ip = _mm256_xor_si256(_mm256_load_si256((const __m256i*)(ips + i)), port);
+        _mm256_storeu_si256((__m256i*)(out + i), fmix64x4(ip));
+    }
+#else
+    for(size_t i = 0; i < batch.size(); i++) {
+        uint64_t seed = TIMED ? fmix64(seeds[i]) : seeds[i];
+        out[i] = fmix64(ips[i] ^ fmix64(ports[i] ^ seed));
+    }
+#endif
+}
+
+#endif //DIGEST_H
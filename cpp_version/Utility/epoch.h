@@ -0,0 +1,142 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "headers.h"
+
+using namespace std;
+
+/* continuous counting over a time-ordered stream: packets go to one of several sketches of a scheme, which is
+ * swapped for an idle one at every epoch of length time slots. The sketch of a closed epoch is flushed,
+ * serialized and handed to done on a background thread, then reset and made idle again; counting waits
+ * only when every other sketch is still being handled. Sketches must not share state that one writes while
+ * another counts: generators are kept per instance, and the thresholds wavelet<false> calibrates in rebuild
+ * are read only by wavelet<true>, which is never rotated beside it */
+class epoch_rotation {
+public:
+    struct epoch {
+        // the epoch covers [id * length, (id + 1) * length)
+        TIME id;
+        abstract_scheme& model;
+        span<const uint8_t> bytes;
+        chrono::duration<double> transform_time;
+    };
+protected:
+    struct slot {
+        unique_ptr<abstract_scheme> model;
+        TIME id = 0;
+        chrono::duration<double> count_time{};
+    };
+
+    TIME length;
+    function<void(const epoch&)> done;
+    vector<slot> slots;
+    // sketches free to count, and sketches of closed epochs in closing order
+    deque<slot*> idle, closed;
+    mutex lock;
+    condition_variable changed;
+    bool stopped = false;
+    slot* current = nullptr;
+    thread runner;
+
+    void run() {
+        bit_writer out;
+        while(true) {
+            slot* s;
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [this] { return stopped || !closed.empty(); });
+                if(closed.empty())
+                    return;
+                s = closed.front();
+                closed.pop_front();
+            }
+            auto start_time = chrono::high_resolution_clock::now();
+            s->model->flush();
+            s->count_time += chrono::high_resolution_clock::now() - start_time;
+            out.clear();
+            s->model->serialize(out);
+            done({s->id, *s->model, out.data(), s->count_time});
+
+            s->model->reset();
+            s->count_time = {};
+            {
+                lock_guard<mutex> guard(lock);
+                idle.push_back(s);
+            }
+            changed.notify_all();
+        }
+    }
+    void close() {
+        if(current == nullptr)
+            return;
+        {
+            lock_guard<mutex> guard(lock);
+            closed.push_back(current);
+        }
+        changed.notify_all();
+        current = nullptr;
+    }
+    void open(TIME id) {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this] { return !idle.empty(); });
+        current = idle.front();
+        idle.pop_front();
+        current->id = id;
+    }
+public:
+    // buffers are reset sketches of one scheme
+    epoch_rotation(vector<unique_ptr<abstract_scheme>> buffers, function<void(const epoch&)> done, TIME length)
+    : length(length), done(move(done)), slots(buffers.size()) {
+        assert(length > 0 && !buffers.empty());
+        for(size_t k = 0; k < slots.size(); k++) {
+            slots[k].model = move(buffers[k]);
+            idle.push_back(&slots[k]);
+        }
+        runner = thread([this] { run(); });
+    }
+    ~epoch_rotation() {
+        finish();
+        {
+            lock_guard<mutex> guard(lock);
+            stopped = true;
+        }
+        changed.notify_all();
+        runner.join();
+    }
+    epoch_rotation(const epoch_rotation&) = delete;
+    epoch_rotation& operator=(const epoch_rotation&) = delete;
+
+    // count a burst of packets in time order, closing the current epoch at the first packet past it
+    void count_batch(span<const PACKET> batch) {
+        while(!batch.empty()) {
+            TIME id = get<1>(batch.front()) / length;
+            if(current == nullptr || current->id != id) {
+                close();
+                open(id);
+            }
+            auto end = get<1>(batch.back()) / length == id ? batch.end() :
+                       upper_bound(batch.begin(), batch.end(), (id + 1) * length - 1,
+                                   [](TIME t, const PACKET& p) { return t < get<1>(p); });
+            size_t n = end - batch.begin();
+
+            auto start_time = chrono::high_resolution_clock::now();
+            current->model->count_batch(batch.first(n));
+            current->count_time += chrono::high_resolution_clock::now() - start_time;
+            batch = batch.subspan(n);
+        }
+    }
+    // close the current epoch and wait until every closed epoch is handled
+    void finish() {
+        close();
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this] { return idle.size() == slots.size(); });
+    }
+};
+
+#endif //EPOCH_H
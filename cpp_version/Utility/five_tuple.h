@@ -1,6 +1,7 @@
 #ifndef FIVE_TUPLE_H
 #define FIVE_TUPLE_H
 
+#include "bit_stream.h"
 #include "murmurhash3.h"
 
 #include <cstdint>
@@ -61,6 +62,36 @@ struct five_tuple {
         return hash_value;
     }
 
+    constexpr static const uint64_t DIGEST_SEED = 0x9E3779B97F4A7C15u;
+    // the two words a digest is mixed from
+    uint64_t ip_word() const {
+        return (uint64_t(src_ip) << 32) | dst_ip;
+    }
+    uint64_t port_word() const {
+        return (uint64_t(src_port) << 24) | (uint64_t(dst_port) << 8) | protocol;
+    }
+    // 64-bit digest over all fields at once; sketch indices of every row are derived from it
+    uint64_t digest(uint64_t seed = DIGEST_SEED) const {
+        return fmix64(ip_word() ^ fmix64(port_word() ^ seed));
+    }
+
+    // the 13 bytes of payload
+    constexpr static const size_t BYTES = 13;
+    void serialize(bit_writer& out) const {
+        out.put(src_ip);
+        out.put(dst_ip);
+        out.put(src_port);
+        out.put(dst_port);
+        out.put(protocol);
+    }
+    void deserialize(bit_reader& in) {
+        src_ip = in.get<uint32_t>();
+        dst_ip = in.get<uint32_t>();
+        src_port = in.get<uint16_t>();
+        dst_port = in.get<uint16_t>();
+        protocol = in.get<uint8_t>();
+    }
+
     friend constexpr strong_ordering operator<=>(const five_tuple& lhs, const five_tuple& rhs) = default;
     friend ostream& operator<<(ostream& os, const five_tuple& t) {
         os << (t.protocol == 6 ? "T" : "U");
@@ -76,7 +107,7 @@ namespace std {
     class hash<five_tuple> {
     public:
         size_t operator()(const five_tuple& t) const {
-            return t.hash();
+            return t.digest();
         }
     };
 }
@@ -0,0 +1,234 @@
+#ifndef FLOW_TABLE_H
+#define FLOW_TABLE_H
+
+#include <bit>
+#include <span>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+/* flat flow store: flows are found by open addressing on their labels,
+ * the series of all flows are laid out one after another in a single arena */
+class flow_table {
+    friend class flow_builder;
+protected:
+    struct range {
+        size_t offset;
+        size_t length;
+    };
+    // flow id + 1, and the high half of the flow digest so that probes rarely touch labels
+    struct slot {
+        uint32_t id;
+        uint32_t tag;
+    };
+    constexpr static const uint32_t EMPTY = 0;
+
+    vector<five_tuple> labels;
+    vector<range> ranges;
+    // size is a power of 2, at most half full
+    vector<slot> index;
+    vector<pair<TIME, DATA>> arena;
+
+    size_t probe(const five_tuple& f, uint64_t digest) const {
+        size_t mask = index.size() - 1;
+        size_t pos = digest & mask;
+        uint32_t tag = digest >> 32;
+        while(index[pos].id != EMPTY && (index[pos].tag != tag || labels[index[pos].id - 1] != f))
+            pos = (pos + 1) & mask;
+        return pos;
+    }
+    void rehash(size_t slots) {
+        index.assign(slots, {EMPTY, 0});
+        for(size_t id = 0; id < labels.size(); id++) {
+            uint64_t digest = labels[id].digest();
+            index[probe(labels[id], digest)] = {uint32_t(id + 1), uint32_t(digest >> 32)};
+        }
+    }
+public:
+    constexpr static const size_t npos = -1;
+
+    class const_iterator {
+        const flow_table* table;
+        size_t id;
+    public:
+        const_iterator(const flow_table* t, size_t i) : table(t), id(i) {}
+        pair<const five_tuple&, SERIES> operator*() const {
+            return {table->labels[id], table->at(id)};
+        }
+        const_iterator& operator++() {
+            id++;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const = default;
+    };
+
+    size_t size() const {
+        return labels.size();
+    }
+    bool empty() const {
+        return labels.empty();
+    }
+    // number of (time, value) points over all flows
+    size_t points() const {
+        return arena.size();
+    }
+    // number of time slots covered by the span of every flow, i.e. points of a dense rebuild
+    size_t slots() const {
+        size_t result = 0;
+        for(auto& r : ranges)
+            if(r.length > 0)
+                result += arena[r.offset + r.length - 1].first - arena[r.offset].first + 1;
+        return result;
+    }
+    void reserve(size_t flows, size_t points = 0) {
+        labels.reserve(flows);
+        ranges.reserve(flows);
+        if(index.size() < flows * 2)
+            rehash(bit_ceil(flows * 2));
+        arena.reserve(points);
+    }
+    void clear() {
+        labels.clear();
+        ranges.clear();
+        index.clear();
+        arena.clear();
+    }
+
+    // id of flow f, or npos if absent
+    size_t find(const five_tuple& f) const {
+        if(index.empty())
+            return npos;
+        auto id = index[probe(f, f.digest())].id;
+        return id == EMPTY ? npos : id - 1;
+    }
+    bool contains(const five_tuple& f) const {
+        return find(f) != npos;
+    }
+    // id of flow f, added with an empty series if absent
+    size_t insert(const five_tuple& f) {
+        if((labels.size() + 1) * 2 > index.size()) [[unlikely]]
+            rehash(max<size_t>(16, index.size() * 2));
+        uint64_t digest = f.digest();
+        auto pos = probe(f, digest);
+        if(index[pos].id == EMPTY) {
+            labels.push_back(f);
+            ranges.push_back({arena.size(), 0});
+            index[pos] = {uint32_t(labels.size()), uint32_t(digest >> 32)};
+        }
+        return index[pos].id - 1;
+    }
+
+    const five_tuple& label(size_t id) const {
+        return labels[id];
+    }
+    SERIES at(size_t id) const {
+        return {arena.data() + ranges[id].offset, ranges[id].length};
+    }
+    span<pair<TIME, DATA>> at(size_t id) {
+        return {arena.data() + ranges[id].offset, ranges[id].length};
+    }
+    // series of flow f, empty if absent
+    SERIES get(const five_tuple& f) const {
+        auto id = find(f);
+        return id == npos ? SERIES{} : at(id);
+    }
+
+    // replace the series of flow f by n points at the end of the arena
+    span<pair<TIME, DATA>> allocate(const five_tuple& f, size_t n) {
+        auto id = insert(f);
+        ranges[id] = {arena.size(), n};
+        arena.resize(arena.size() + n);
+        return at(id);
+    }
+    template<typename It>
+    void assign(const five_tuple& f, It first, It last) {
+        auto id = insert(f);
+        ranges[id].offset = arena.size();
+        arena.insert(arena.end(), first, last);
+        ranges[id].length = arena.size() - ranges[id].offset;
+    }
+    template<typename R>
+    void assign(const five_tuple& f, const R& series) {
+        assign(f, series.begin(), series.end());
+    }
+
+    const_iterator begin() const {
+        return {this, 0};
+    }
+    const_iterator end() const {
+        return {this, labels.size()};
+    }
+};
+
+/* collects points of interleaved flows in arrival order, then lays them out flow by flow */
+class flow_builder {
+protected:
+    flow_table flows;
+    vector<uint32_t> owner;
+    vector<pair<TIME, DATA>> points;
+    // per flow: index of its last point and number of points
+    vector<size_t> last;
+    vector<size_t> count;
+
+    size_t push_point(size_t id, TIME t, DATA c) {
+        owner.push_back(id);
+        points.emplace_back(t, c);
+        last[id] = points.size() - 1;
+        count[id]++;
+        return last[id];
+    }
+    size_t flow(const five_tuple& f) {
+        auto id = flows.insert(f);
+        if(id == last.size()) {
+            last.push_back(0);
+            count.push_back(0);
+        }
+        return id;
+    }
+public:
+    // append a point to flow f
+    void push(const five_tuple& f, TIME t, DATA c) {
+        push_point(flow(f), t, c);
+    }
+    // add c to flow f at time t; points of a flow arrive in time order
+    void add(const five_tuple& f, TIME t, DATA c) {
+        auto id = flow(f);
+        if(count[id] == 0 || points[last[id]].first < t)
+            push_point(id, t, c);
+        else
+            points[last[id]].second += c;
+    }
+    // keep the first and the last time of flow f
+    void extend(const five_tuple& f, TIME t) {
+        auto id = flow(f);
+        if(count[id] < 2)
+            push_point(id, t, 0);
+        else
+            points[last[id]].first = t;
+    }
+
+    flow_table build() {
+        flow_table result = move(flows);
+        result.arena.resize(points.size());
+        size_t offset = 0;
+        for(size_t id = 0; id < count.size(); id++) {
+            result.ranges[id] = {offset, 0};
+            offset += count[id];
+        }
+        for(size_t k = 0; k < points.size(); k++) {
+            auto& r = result.ranges[owner[k]];
+            result.arena[r.offset + r.length++] = points[k];
+        }
+
+        flows = flow_table();
+        owner.clear();
+        points.clear();
+        last.clear();
+        count.clear();
+        return result;
+    }
+};
+
+#endif //FLOW_TABLE_H
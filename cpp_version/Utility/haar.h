@@ -0,0 +1,105 @@
+#ifndef HAAR_H
+#define HAAR_H
+
+#include <array>
+#include <bit>
+
+#include "types.h"
+#include "murmurhash3.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// the lowest levels of the inverse transform are done together within one vector of this many coefficients
+#if defined(__AVX512F__)
+#define HAAR_LANES 16u
+#elif defined(__AVX2__)
+#define HAAR_LANES 8u
+#else
+#define HAAR_LANES 1u
+#endif
+
+// lanes holding the high coefficient of a pair of the level of half-width H
+template<uint32_t N, uint32_t H>
+constexpr uint32_t haar_high() {
+    uint32_t mask = 0;
+    for(uint32_t j = 0; j < N; j++)
+        if(j % (2 * H) == H)
+            mask |= 1u << j;
+    return mask;
+}
+// lanes swap with their pair, and lanes of no pair stay
+template<uint32_t N, uint32_t H>
+constexpr array<int32_t, N> haar_partner() {
+    array<int32_t, N> result{};
+    for(uint32_t j = 0; j < N; j++)
+        result[j] = j % (2 * H) == 0 ? j + H : j % (2 * H) == H ? j - H : j;
+    return result;
+}
+
+/* each step takes (lo, hi) to ((lo + hi) / 2, (lo - hi) / 2) rounding toward zero as the scalar division does.
+ * Lanes of no pair at a level are their own partner, so (v + v) / 2 leaves them */
+#if defined(__AVX512F__)
+static FORCE_INLINE __m512i half32x16(__m512i x) {
+    return _mm512_srai_epi32(_mm512_add_epi32(x, _mm512_srli_epi32(x, 31)), 1);
+}
+template<uint32_t H>
+static FORCE_INLINE __m512i inverse_step16(__m512i v) {
+    constexpr static auto partner = haar_partner<16, H>();
+    __m512i p = _mm512_permutexvar_epi32(_mm512_loadu_si512(partner.data()), v);
+    return half32x16(_mm512_mask_blend_epi32(haar_high<16, H>(), _mm512_add_epi32(v, p), _mm512_sub_epi32(p, v)));
+}
+#elif defined(__AVX2__)
+static FORCE_INLINE __m256i half32x8(__m256i x) {
+    return _mm256_srai_epi32(_mm256_add_epi32(x, _mm256_srli_epi32(x, 31)), 1);
+}
+template<uint32_t H>
+static FORCE_INLINE __m256i inverse_step8(__m256i v) {
+    constexpr static auto partner = haar_partner<8, H>();
+    __m256i p = _mm256_permutevar8x32_epi32(v, _mm256_loadu_si256((const __m256i*)partner.data()));
+    return half32x8(_mm256_blend_epi32(_mm256_add_epi32(v, p), _mm256_sub_epi32(p, v), haar_high<8, H>()));
+}
+#endif
+
+/* in-place inverse Haar transform of the first n coefficients of a section of 2^levels, level by level from the top;
+ * only pairs whose block ends within n are transformed, as for a section still being filled. Equal to
+ * transforming block by block in any order that puts every block after the one containing it */
+inline void inverse_haar(DATA* data, uint32_t n, int levels) {
+    constexpr int fused = countr_zero(HAAR_LANES);
+    int top = levels >= fused ? fused : 0;
+    for(int i = levels - 1; i >= top; i--)
+        for(uint32_t b = 0; b + (2u << i) <= n; b += 2u << i) {
+            DATA lo = data[b], hi = data[b + (1u << i)];
+            data[b] = (lo + hi) / 2;
+            data[b + (1u << i)] = (lo - hi) / 2;
+        }
+
+    uint32_t a = 0;
+    if(top > 0) {
+#if defined(__AVX512F__)
+        for(; a + 16 <= n; a += 16) {
+            __m512i v = _mm512_loadu_si512(data + a);
+            v = inverse_step16<1>(inverse_step16<2>(inverse_step16<4>(inverse_step16<8>(v))));
+            _mm512_storeu_si512(data + a, v);
+        }
+#elif defined(__AVX2__)
+        for(; a + 8 <= n; a += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(data + a));
+            v = inverse_step8<1>(inverse_step8<2>(inverse_step8<4>(v)));
+            _mm256_storeu_si256((__m256i*)(data + a), v);
+        }
+#endif
+    }
+    // the fused levels over what is left of a partial section
+    for(int i = top - 1; i >= 0; i--)
+        for(uint32_t b = a; b + (2u << i) <= n; b += 2u << i) {
+            DATA lo = data[b], hi = data[b + (1u << i)];
+            data[b] = (lo + hi) / 2;
+            data[b + (1u << i)] = (lo - hi) / 2;
+        }
+}
+
+#endif //HAAR_H
@@ -10,6 +10,7 @@
 #include "counter.h"
 #include "table.h"
 #include "scheme.h"
+#include "alloc_count.h"
 
 #include "murmurhash3.h"
 #include "pffft.h"
@@ -29,7 +30,10 @@
 #include <random>
 #include <regex>
 #include <set>
+#include <sstream>
+#include <span>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
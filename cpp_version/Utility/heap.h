@@ -2,6 +2,7 @@
 #define HEAP_H
 
 #include "parameter.h"
+#include "bit_stream.h"
 
 #include <cstdint>
 #include <array>
@@ -17,20 +18,19 @@
 
 using namespace std;
 
-// serializability concept
+// serializability concept; serialize(out) writes exactly the bytes serialize() counts
 template<typename T>
-concept Serializable = requires(T a) {
-    { a.serialize() } -> std::convertible_to<std::size_t>;
+concept Serializable = requires(T a, const T& ca, bit_writer& out, bit_reader& in) {
+    { ca.serialize() } -> std::convertible_to<std::size_t>;
+    ca.serialize(out);
+    a.deserialize(in);
 };
 
+/* heaps are embedded in counters and dispatched statically; every heap provides
+ *   void reset(); T insert(T r); const T* begin() const; const T* end() const; size_t serialize() const;
+ *   void serialize(bit_writer& out) const; void deserialize(bit_reader& in); void prefetch() const; */
 template<Serializable T>
 class abstract_heap {
-public:
-    virtual void reset() = 0;
-    virtual T insert(T r) = 0;
-    virtual const T* begin() const = 0;
-    virtual const T* end() const = 0;
-    virtual size_t serialize() const = 0;
 };
 
 template<Serializable T, uint32_t SIZE>
@@ -89,6 +89,12 @@ public:
         return heap_data + size;
     }
 
+    // the root and the size, read by every insertion
+    void prefetch() const {
+        __builtin_prefetch(heap_data, 1);
+        __builtin_prefetch(&size, 1);
+    }
+
     template<uint32_t I>
     heap<T, SIZE>& operator=(heap<T, I> other) {
         static_assert(SIZE >= I);
@@ -97,20 +103,31 @@ public:
         return *this;
     }
 
-    size_t serialize() const override {
+    size_t serialize() const {
         size_t result = 0;
         result += sizeof(size);
         for(int i = 0; i < size; i++)
             result += heap_data[i].serialize();
         return result;
     }
+    void serialize(bit_writer& out) const {
+        out.put(size);
+        for(int i = 0; i < size; i++)
+            heap_data[i].serialize(out);
+    }
+    void deserialize(bit_reader& in) {
+        size = in.get<uint16_t>();
+        for(int i = 0; i < size; i++)
+            heap_data[i].deserialize(in);
+    }
 };
 
 template<Serializable T, uint32_t SIZE>
 // a priority queue approximated by threshold-based array; when full, randomly evicts historical data
 class pseudo_heap : public abstract_heap<T> {
 protected:
-    static mt19937 gen;
+    // per heap, so that evictions do not depend on the thread counting it; reseeded by the owner
+    minstd_rand gen{0xAEABDC85u};
 
     T push_hi(T r) {
         heap_data[size_hi] = r;
@@ -150,6 +167,9 @@ public:
         size_hi = 0;
         size_lo = SIZE - 1;
     }
+    void seed(uint32_t s) {
+        gen.seed(s);
+    }
 
     T insert(T r) {
         if(r < thresh_lo)
@@ -177,7 +197,11 @@ public:
         return heap_data + size_hi;
     }
 
-    size_t serialize() const override {
+    void prefetch() const {
+        __builtin_prefetch(&size_hi, 1);
+    }
+
+    size_t serialize() const {
         size_t result = 0;
         result += sizeof(size_hi);
         for(int i = 0; i < size_hi; i++)
@@ -186,10 +210,26 @@ public:
             result += heap_data[i].serialize();
         return result;
     }
+    // both fill counts are packed into the 16 bits counted for size_hi
+    void serialize(bit_writer& out) const {
+        static_assert(SIZE < 256);
+        out.write(size_hi, 8);
+        out.write(SIZE - 1 - size_lo, 8);
+        for(int i = 0; i < size_hi; i++)
+            heap_data[i].serialize(out);
+        for(int i = SIZE - 1; i > size_lo; i--)
+            heap_data[i].serialize(out);
+    }
+    void deserialize(bit_reader& in) {
+        size_hi = in.read(8);
+        size_lo = SIZE - 1 - in.read(8);
+        for(int i = 0; i < size_hi; i++)
+            heap_data[i].deserialize(in);
+        for(int i = SIZE - 1; i > size_lo; i--)
+            heap_data[i].deserialize(in);
+    }
 };
 
-template<Serializable T, uint32_t SIZE>
-mt19937 pseudo_heap<T, SIZE>::gen(0xAEABDC85);
 template<Serializable T, uint32_t SIZE>
 T pseudo_heap<T, SIZE>::thresh_hi{};//740, 49};
 template<Serializable T, uint32_t SIZE>
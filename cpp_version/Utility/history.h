@@ -0,0 +1,195 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <atomic>
+#include <iterator>
+#include <vector>
+
+#include "parameter.h"
+#include "debug.h"
+#include "types.h"
+#include "bit_stream.h"
+#include "counter.h"
+
+using namespace std;
+
+/* allocations made by history stores, to tell the counting path apart from the rest */
+struct history_stats {
+    // rings allocated, counters spilled, spill buffer growths and counters decoded back
+    inline static atomic<size_t> rings{0}, spills{0}, growths{0}, thaws{0};
+};
+
+/* saved counters of one table cell in time order, each kept in the sealed form of C. The newest HISTORY_SLOTS
+ * counters live in a ring allocated once and kept over reset; older ones are spilled bit-packed, and are decoded
+ * again by thaw, which tables call once a history is complete. With HISTORY_RETENTION, spilled counters ending that
+ * many time slots before the latest spill are dropped. Const reads never decode, so they may run side by side */
+template<typename C>
+class bounded_history {
+protected:
+    typedef typename sealed_of<C>::type S;
+
+    struct frozen {
+        TIME start;
+        size_t offset;
+    };
+
+    vector<S> ring;
+    size_t head = 0;
+    size_t live = 0;
+    // spilled counters back to back, each padded to whole bytes; entries before first are dropped
+    vector<uint8_t> spill;
+    vector<frozen> index;
+    size_t first = 0;
+    // decoded spilled counters, valid while warm
+    vector<S> thawed;
+    bool warm = true;
+
+    size_t end_of(size_t k) const {
+        return k + 1 < index.size() ? index[k + 1].offset : spill.size();
+    }
+    void freeze(const S& c) {
+        thread_local bit_writer out;
+        out.clear();
+        c.serialize(out);
+        auto bytes = out.data();
+        if(spill.size() + bytes.size() > spill.capacity())
+            history_stats::growths++;
+        index.push_back({c.start(), spill.size()});
+        spill.insert(spill.end(), bytes.begin(), bytes.end());
+        history_stats::spills++;
+        thawed.clear();
+        warm = false;
+
+        if constexpr(HISTORY_RETENTION > 0) {
+            while(first < index.size() && index[first].start + MAX_LENGTH + HISTORY_RETENTION <= c.start())
+                first++;
+            // give the dropped bytes back once they are the larger part
+            size_t dropped = first < index.size() ? index[first].offset : spill.size();
+            if(first > 0 && dropped * 2 > spill.size()) {
+                spill.erase(spill.begin(), spill.begin() + dropped);
+                index.erase(index.begin(), index.begin() + first);
+                for(auto& e : index)
+                    e.offset -= dropped;
+                first = 0;
+            }
+        }
+    }
+public:
+    // decode the counters spilled since the last thaw; required before const reads
+    void thaw() {
+        if(warm) [[likely]]
+            return;
+        thawed.clear();
+        thawed.reserve(index.size() - first);
+        for(size_t k = first; k < index.size(); k++) {
+            bit_reader in(span<const uint8_t>(spill).subspan(index[k].offset, end_of(k) - index[k].offset));
+            thawed.emplace_back().deserialize(in);
+            history_stats::thaws++;
+        }
+        warm = true;
+    }
+
+protected:
+    template<typename H, typename V>
+    class basic_iterator {
+        H* owner = nullptr;
+        ptrdiff_t pos = 0;
+    public:
+        using iterator_category = random_access_iterator_tag;
+        using value_type = S;
+        using difference_type = ptrdiff_t;
+        using pointer = V*;
+        using reference = V&;
+
+        basic_iterator() = default;
+        basic_iterator(H* h, ptrdiff_t p) : owner(h), pos(p) {}
+
+        reference operator*() const { return (*owner)[pos]; }
+        pointer operator->() const { return &(*owner)[pos]; }
+        reference operator[](difference_type n) const { return (*owner)[pos + n]; }
+        basic_iterator& operator++() { pos++; return *this; }
+        basic_iterator operator++(int) { return {owner, pos++}; }
+        basic_iterator& operator--() { pos--; return *this; }
+        basic_iterator operator--(int) { return {owner, pos--}; }
+        basic_iterator& operator+=(difference_type n) { pos += n; return *this; }
+        basic_iterator& operator-=(difference_type n) { pos -= n; return *this; }
+        friend basic_iterator operator+(basic_iterator it, difference_type n) { return it += n; }
+        friend basic_iterator operator+(difference_type n, basic_iterator it) { return it += n; }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const basic_iterator& l, const basic_iterator& r) { return l.pos - r.pos; }
+        friend bool operator==(const basic_iterator& l, const basic_iterator& r) { return l.pos == r.pos; }
+        friend auto operator<=>(const basic_iterator& l, const basic_iterator& r) { return l.pos <=> r.pos; }
+    };
+public:
+    using iterator = basic_iterator<bounded_history, S>;
+    using const_iterator = basic_iterator<const bounded_history, const S>;
+
+    size_t size() const {
+        return index.size() - first + live;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    // the ring is kept for reuse
+    void clear() {
+        head = live = 0;
+        spill.clear();
+        index.clear();
+        first = 0;
+        thawed.clear();
+        warm = true;
+    }
+
+protected:
+    // the next slot of the ring, spilling the oldest counter when it is full
+    S& claim() {
+        if(ring.empty()) [[unlikely]] {
+            ring.resize(HISTORY_SLOTS);
+            history_stats::rings++;
+        }
+        if(live == ring.size()) {
+            freeze(ring[head]);
+            head = (head + 1) % ring.size();
+            live--;
+        }
+        live++;
+        return ring[(head + live - 1) % ring.size()];
+    }
+public:
+    void push_back(const C& c) {
+        if constexpr(is_same_v<S, C>)
+            claim() = c;
+        else
+            claim().seal(c);
+    }
+    // a reset counter appended to be filled in place
+    S& emplace_back() {
+        S& slot = claim();
+        slot.reset();
+        return slot;
+    }
+
+    // counters in time order, spilled ones first
+    const S& operator[](size_t k) const {
+        assert(warm);
+        return k < thawed.size() ? thawed[k] : ring[(head + k - thawed.size()) % ring.size()];
+    }
+    S& operator[](size_t k) {
+        thaw();
+        return k < thawed.size() ? thawed[k] : ring[(head + k - thawed.size()) % ring.size()];
+    }
+    const_iterator begin() const {
+        return {this, 0};
+    }
+    const_iterator end() const {
+        return {this, ptrdiff_t(size())};
+    }
+    iterator begin() {
+        return {this, 0};
+    }
+    iterator end() {
+        return {this, ptrdiff_t(size())};
+    }
+};
+
+#endif //HISTORY_H
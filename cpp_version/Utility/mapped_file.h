@@ -0,0 +1,84 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* read-only memory-mapped file */
+class mapped_file {
+protected:
+    const char* ptr = nullptr;
+    size_t length = 0;
+    bool opened = false;
+public:
+    mapped_file() = default;
+    explicit mapped_file(const string& fname) {
+        int fd = ::open(fname.c_str(), O_RDONLY);
+        if(fd < 0) [[unlikely]]
+            return;
+
+        struct stat st{};
+        if(fstat(fd, &st) == 0) [[likely]] {
+            length = st.st_size;
+            opened = true;
+            if(length > 0) {
+                void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(p == MAP_FAILED) [[unlikely]] {
+                    length = 0;
+                    opened = false;
+                } else {
+                    ptr = static_cast<const char*>(p);
+                    madvise(p, length, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        ::close(fd);
+    }
+    ~mapped_file() {
+        if(ptr != nullptr)
+            munmap(const_cast<char*>(ptr), length);
+    }
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept
+    : ptr(exchange(other.ptr, nullptr)), length(exchange(other.length, 0)), opened(exchange(other.opened, false)) {}
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        swap(ptr, other.ptr);
+        swap(length, other.length);
+        swap(opened, other.opened);
+        return *this;
+    }
+
+    // drop resident pages fully inside [from, to); they are read again from the file on access
+    void release(const char* from, const char* to) const {
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t l = (reinterpret_cast<uintptr_t>(from) + page - 1) / page * page;
+        uintptr_t r = reinterpret_cast<uintptr_t>(to) / page * page;
+        if(l < r)
+            madvise(reinterpret_cast<void*>(l), r - l, MADV_DONTNEED);
+    }
+
+    bool is_open() const {
+        return opened;
+    }
+    const char* begin() const {
+        return ptr;
+    }
+    const char* end() const {
+        return ptr + length;
+    }
+    size_t size() const {
+        return length;
+    }
+};
+
+#endif //MAPPED_FILE_H
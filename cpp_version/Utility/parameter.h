@@ -30,10 +30,18 @@
 //#define WAVE_DEPTH 55u
 //#define PAMS_DEPTH 24u
 #define PCMS_DELTA (SAMPLE_RATE * 2)
+#define ROUND_UP(a, b) (((a) + (b) - 1) / (b) * (b))
 #define ROUND(a, b) ((a) / (b) + (((b) & 1) == 0 ? (a) % (b) >= (b) / 2 : (a) % (b) > (b) / 2))
 
 #define BUCKET (FULL_WIDTH * FULL_HEIGHT)
-#define MEMORY (FULL_WIDTH * FULL_HEIGHT * FULL_DEPTH * 4)
+#define MEMORY_OF(w) ((w) * FULL_HEIGHT * FULL_DEPTH * 4)
+#define MEMORY MEMORY_OF(FULL_WIDTH)
+// table widths instantiated for runtime memory selection
+#define SWEEP_WIDTHS 8u, 16u, 32u, 64u, 128u
+// packets whose counters are prefetched ahead of their update in a batch
+#define PREFETCH_AHEAD 8u
+// time slots a range query decodes together
+#define QUERY_BLOCK 256u
 // window for FFT
 #define WINDOW (max(32u, bit_ceil(SAMPLE_RATE) * 2u))
 // score multiplier for stored flow
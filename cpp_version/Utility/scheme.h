@@ -18,16 +18,34 @@ protected:
         return array_iota_impl<T, N>(make_index_sequence<N>{});
     }
 public:
+    // schemes are owned through unique_ptr<abstract_scheme>
+    virtual ~abstract_scheme() = default;
     // reset all related data structures
     virtual void reset() = 0;
     // count individual packet arriving at time t
     virtual void count(const five_tuple& f, const TIME t, const DATA c) = 0;
+    // count a burst of packets in arrival order
+    virtual void count_batch(span<const PACKET> batch) {
+        for(auto& [f, t, c] : batch)
+            count(f, t, c);
+    }
     // finish recording and deal with remaining buffered data
     virtual void flush() = 0;
     // rebuild counters for a label-set in all available timestamps
     virtual STREAM rebuild(const STREAM& dict) const = 0;
+    /* the count of f in time slot t, as rebuild would give it. Valid after flush; wavelet schemes read only their
+     * coefficients and may be queried from several threads at once, while the other schemes fill the rebuild caches
+     * of their counters, so one of their sketches is not thread-safe to query or rebuild concurrently */
+    virtual DATA query_point(const five_tuple& f, TIME t) const = 0;
+    // total and largest count of f over the time slots of [a, b]
+    virtual int64_t query_sum(const five_tuple& f, TIME a, TIME b) const = 0;
+    virtual DATA query_max(const five_tuple& f, TIME a, TIME b) const = 0;
     // serialize related data structures
     virtual size_t serialize() const = 0;
+    // write the bytes counted by serialize() after flush, enough to rebuild
+    virtual void serialize(bit_writer& out) const = 0;
+    // restore the state written by serialize(out); only rebuild is valid afterward
+    virtual void deserialize(bit_reader& in) = 0;
 };
 
 template<DerivedTable T>
@@ -43,21 +61,37 @@ public:
         sketch.count(f, t, c);
     }
 
+    void count_batch(span<const PACKET> batch) override {
+        sketch.count_batch(batch);
+    }
+
     void flush() override {
         sketch.flush();
     }
 
     STREAM rebuild(const STREAM& dict) const override {
-        STREAM result;
-        for(auto& p : dict)
-            result[p.first] = sketch.rebuild(p.first, p.second.front().first, p.second.back().first);
+        return sketch.rebuild_all(dict);
+    }
 
-        return result;
+    DATA query_point(const five_tuple& f, TIME t) const override {
+        return sketch.query_point(f, t);
+    }
+    int64_t query_sum(const five_tuple& f, TIME a, TIME b) const override {
+        return sketch.query_sum(f, a, b);
+    }
+    DATA query_max(const five_tuple& f, TIME a, TIME b) const override {
+        return sketch.query_max(f, a, b);
     }
 
     virtual size_t serialize() const override {
         return sketch.serialize();
     }
+    void serialize(bit_writer& out) const override {
+        sketch.serialize(out);
+    }
+    void deserialize(bit_reader& in) override {
+        sketch.deserialize(in);
+    }
 };
 
 template<typename T>
@@ -0,0 +1,167 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "headers.h"
+#include "digest.h"
+#include "spsc_ring.h"
+
+using namespace std;
+
+/* N instances of scheme S, each counting its share of the flows on a thread of its own;
+ * flows are partitioned by digest and handed over through one SPSC ring per shard.
+ * count, count_batch, flush and reset must come from one thread at a time */
+template<DerivedScheme S, unsigned N = SHARDS>
+class sharded : public abstract_scheme {
+protected:
+    struct worker {
+        spsc_ring<PACKET> ring{RING_SIZE};
+        // packets pushed by the producer, and counted by the shard
+        size_t pushed = 0;
+        atomic<size_t> counted{0};
+        // bumped by the producer to wake the shard up
+        atomic<size_t> signal{0};
+        atomic<bool> stopped{false};
+        thread runner;
+
+        void wake() {
+            signal.fetch_add(1, memory_order_release);
+            signal.notify_one();
+        }
+        // block until the shard has counted every pushed packet
+        void drain() {
+            wake();
+            for(size_t c; (c = counted.load(memory_order_acquire)) != pushed;)
+                counted.wait(c, memory_order_acquire);
+        }
+    };
+
+    array<S, N> shards{};
+    array<worker, N> workers{};
+
+    static unsigned shard_of(uint64_t digest) {
+        return ((digest >> 32) * N) >> 32;
+    }
+    void run(S& shard, worker& w) {
+        vector<PACKET> buffer(BATCH_SIZE);
+        while(true) {
+            size_t s = w.signal.load(memory_order_acquire);
+            size_t n = w.ring.pop(buffer);
+            if(n > 0) {
+                shard.count_batch(span<const PACKET>(buffer.data(), n));
+                w.counted.fetch_add(n, memory_order_release);
+                w.counted.notify_all();
+                continue;
+            }
+            if(w.stopped.load(memory_order_acquire))
+                return;
+            w.signal.wait(s, memory_order_acquire);
+        }
+    }
+    void drain() {
+        for(auto& w : workers)
+            w.drain();
+    }
+public:
+    sharded() {
+        for(unsigned k = 0; k < N; k++)
+            workers[k].runner = thread([this, k] { run(shards[k], workers[k]); });
+    }
+    ~sharded() {
+        for(auto& w : workers) {
+            w.stopped.store(true, memory_order_release);
+            w.wake();
+        }
+        for(auto& w : workers)
+            w.runner.join();
+    }
+    sharded(const sharded&) = delete;
+    sharded& operator=(const sharded&) = delete;
+
+    void reset() override {
+        drain();
+        for(auto& s : shards)
+            s.reset();
+    }
+
+    void count(const five_tuple& f, const TIME t, const DATA c) override {
+        PACKET p{f, t, c};
+        count_batch({&p, 1});
+    }
+
+    void count_batch(span<const PACKET> batch) override {
+        thread_local vector<uint64_t> digest;
+        digest.resize(ROUND_UP(batch.size(), DIGEST_BATCH));
+        for(size_t pos = 0; pos < batch.size(); pos += DIGEST_BATCH)
+            digest_batch(batch.subspan(pos, min<size_t>(DIGEST_BATCH, batch.size() - pos)), &digest[pos]);
+
+        for(size_t i = 0; i < batch.size(); i++) {
+            auto& w = workers[shard_of(digest[i])];
+            while(!w.ring.push(batch[i])) [[unlikely]] {
+                w.wake();
+                size_t c = w.counted.load(memory_order_acquire);
+                if(w.ring.full())
+                    w.counted.wait(c, memory_order_acquire);
+            }
+            w.pushed++;
+        }
+        for(auto& w : workers)
+            w.wake();
+    }
+
+    void flush() override {
+        drain();
+        for(auto& s : shards)
+            s.flush();
+    }
+
+    // shards are rebuilt one after another on their own flows; wavelet<false> calibrates shared thresholds there
+    STREAM rebuild(const STREAM& dict) const override {
+        array<STREAM, N> parts;
+        for(auto [f, q] : dict)
+            parts[shard_of(f.digest())].assign(f, q);
+        for(unsigned k = 0; k < N; k++)
+            parts[k] = shards[k].rebuild(parts[k]);
+
+        STREAM result;
+        size_t points = 0;
+        for(auto& p : parts)
+            points += p.points();
+        result.reserve(dict.size(), points);
+        for(auto [f, q] : dict)
+            result.assign(f, parts[shard_of(f.digest())].get(f));
+        return result;
+    }
+
+    // a flow is answered by its own shard
+    DATA query_point(const five_tuple& f, TIME t) const override {
+        return shards[shard_of(f.digest())].query_point(f, t);
+    }
+    int64_t query_sum(const five_tuple& f, TIME a, TIME b) const override {
+        return shards[shard_of(f.digest())].query_sum(f, a, b);
+    }
+    DATA query_max(const five_tuple& f, TIME a, TIME b) const override {
+        return shards[shard_of(f.digest())].query_max(f, a, b);
+    }
+
+    size_t serialize() const override {
+        size_t result = 0;
+        for(auto& s : shards)
+            result += s.serialize();
+        return result;
+    }
+    void serialize(bit_writer& out) const override {
+        for(auto& s : shards)
+            s.serialize(out);
+    }
+    void deserialize(bit_reader& in) override {
+        drain();
+        for(auto& s : shards)
+            s.deserialize(in);
+    }
+};
+
+#endif //SHARDED_H
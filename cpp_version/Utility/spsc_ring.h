@@ -0,0 +1,48 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <bit>
+#include <span>
+#include <vector>
+
+using namespace std;
+
+/* bounded lock-free queue between exactly one producer thread and one consumer thread */
+template<typename T>
+class spsc_ring {
+protected:
+    vector<T> slots;
+    size_t mask;
+    // next slot to read, written by the consumer only
+    alignas(64) atomic<size_t> head{0};
+    // next slot to write, written by the producer only
+    alignas(64) atomic<size_t> tail{0};
+public:
+    explicit spsc_ring(size_t capacity) : slots(bit_ceil(capacity)), mask(slots.size() - 1) {}
+
+    // false if the ring is full
+    bool push(const T& v) {
+        size_t t = tail.load(memory_order_relaxed);
+        if(t - head.load(memory_order_acquire) == slots.size()) [[unlikely]]
+            return false;
+        slots[t & mask] = v;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+    // move up to out.size() items to out, return the number moved
+    size_t pop(span<T> out) {
+        size_t h = head.load(memory_order_relaxed);
+        size_t n = min(out.size(), tail.load(memory_order_acquire) - h);
+        for(size_t i = 0; i < n; i++)
+            out[i] = slots[(h + i) & mask];
+        head.store(h + n, memory_order_release);
+        return n;
+    }
+
+    bool full() const {
+        return tail.load(memory_order_acquire) - head.load(memory_order_acquire) == slots.size();
+    }
+};
+
+#endif //SPSC_RING_H
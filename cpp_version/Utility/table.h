@@ -1,48 +1,100 @@
 #ifndef TABLE_H
 #define TABLE_H
 
+#include <bit>
+#include <bitset>
 #include <map>
+#include <span>
 
 #include "counter.h"
+#include "digest.h"
+#include "history.h"
+#include "work_pool.h"
 
 using namespace std;
 
+/* tables are held by value in schemes and dispatched statically; every table provides
+ *   void reset();                   reset all related data structures; act as an empty table afterward
+ *   bool count(const five_tuple& f, TIME t, DATA c);  return true if inserted successfully
+ *   void count_batch(span<const PACKET> batch);        count a burst of packets in arrival order
+ *   void prefetch(uint64_t digest) const;             hint the counters a digest is counted into
+ *   void flush();                   finish recording and deal with remaining buffered data
+ *   void rebuild(const five_tuple& f, TIME start, TIME last, span<pair<TIME, DATA>> out) const;
+ *                                   rebuild counters of f in [start, last] into out of last - start + 1 points
+ *   STREAM rebuild_all(const STREAM& dict) const;  rebuild every flow of dict over the span of its series
+ *   void query(const five_tuple& f, TIME a, TIME b, F out) const;  hand out(t, value) the values rebuild gives f in [a, b]
+ *   size_t serialize() const;       serialize all the non-empty counters in table
+ *   void serialize(bit_writer& out) const;  write the bytes counted by serialize()
+ *   void deserialize(bit_reader& in);       restore a flushed table written by serialize(out) */
 class abstract_table {
-public:
-    // reset all related data structures; act as an empty table afterward
-    virtual void reset() = 0;
-    // return true if inserted successfully
-    virtual bool count(const five_tuple& f, TIME t, DATA c) = 0;
-    // finish recording and deal with remaining buffered data
-    virtual void flush() = 0;
-    // rebuild counters of five-tuple f in all possible time-window
-    virtual STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const = 0;
-    // serialize all the non-empty counters in table
-    virtual size_t serialize() const = 0;
 };
 
-template<DerivedCounter C = abstract_counter, int W = FULL_WIDTH, int H = FULL_HEIGHT>
+// threads flows are rebuilt on, read at the first rebuild; 0 for hardware concurrency
+inline unsigned rebuild_threads = REBUILD_THREADS;
+inline work_pool& rebuild_pool() {
+    static work_pool pool(rebuild_threads);
+    return pool;
+}
+
+// f(lo, hi) for [a, b] cut in blocks of QUERY_BLOCK time slots, in time order
+template<typename F>
+void for_each_block(TIME a, TIME b, F&& f) {
+    for(TIME lo = a; lo <= b; lo += QUERY_BLOCK) {
+        TIME hi = b - lo < QUERY_BLOCK ? b : lo + QUERY_BLOCK - 1;
+        f(lo, hi);
+        if(hi == b)
+            break;
+    }
+}
+
+// D is the derived table; hooks derived_reset, save_counter, select_val and digest_packets are resolved on D
+template<typename D, DerivedCounter C, int W = FULL_WIDTH, int H = FULL_HEIGHT>
 class basic_table : public abstract_table {
 protected:
-    constexpr static const HASH seeds[] = {0x5A5A5A5A, 0x42424242, 0xDEADBEEF, 0x12345678};
+    D& derived() {
+        return static_cast<D&>(*this);
+    }
+    const D& derived() const {
+        return static_cast<const D&>(*this);
+    }
+
     constexpr static const int WIDTH = W;
     constexpr static const int HEIGHT = H;
-    static_assert(sizeof(seeds) / sizeof(HASH) >= HEIGHT);
     static_assert(HEIGHT > 0);
 
     C counters[HEIGHT][WIDTH]{};
-    deque<C> history[HEIGHT][WIDTH]{};
+    bounded_history<C> history[HEIGHT][WIDTH]{};
+
+    // column and quotient of a digest in row, by double hashing on its two halves
+    static pair<HASH, HASH> locate(uint64_t digest, HASH row) {
+        uint32_t h = uint32_t(digest) + uint32_t(row) * (uint32_t(digest >> 32) | 1u);
+        if constexpr(has_single_bit(unsigned(WIDTH)))
+            return {h & (WIDTH - 1), h >> countr_zero(unsigned(WIDTH))};
+        else
+            return {h % WIDTH, h / WIDTH};
+    }
+
+    // digests of a batch of packets, as count(digest, t, c) of D expects them
+    static void digest_packets(span<const PACKET> batch, uint64_t* out) {
+        digest_batch(batch, out);
+    }
 
-    virtual void derived_reset() { }
-    virtual void save_counter(HASH row, HASH col) {
+    void derived_reset() { }
+    void save_counter(HASH row, HASH col) {
         history[row][col].push_back(counters[row][col]);
         counters[row][col].reset();
     }
-    static auto first_history(const deque<C>& qc, TIME start) {
+    // decode what every cell has spilled, so that reads of a complete table leave it untouched
+    void thaw_history() {
+        for(auto& row : history)
+            for(auto& c : row)
+                c.thaw();
+    }
+    static auto first_history(const bounded_history<C>& qc, TIME start) {
         return upper_bound(qc.begin(), qc.end(), start,
-                             [](const TIME t, const C& c) { return c.start() + MAX_LENGTH > t; });
+                             [](const TIME t, const auto& c) { return c.start() + MAX_LENGTH > t; });
     }
-    virtual DATA select_median(array<DATA, HEIGHT>& vals) const {
+    DATA select_median(array<DATA, HEIGHT>& vals) const {
         int size = vals.size();
         sort(vals.begin(), vals.end());
         DATA median = 0;
@@ -56,7 +108,7 @@ protected:
 
         return median;
     }
-    virtual DATA select_min(array<DATA, HEIGHT>& vals) const {
+    DATA select_min(array<DATA, HEIGHT>& vals) const {
         DATA min = *min_element(vals.begin(), vals.end());
         assert(min >= 0);
         if(min < 0)
@@ -65,13 +117,41 @@ protected:
         return min;
     }
 
-    virtual DATA select_val(array<DATA, HEIGHT>& vals) const {
+    DATA select_val(array<DATA, HEIGHT>& vals) const {
         return select_min(vals);
     }
+
+    // points of a saved counter within [a, b] to out(t, value) in time order, decoded in place if it can be
+    template<typename S, typename F>
+    static void scan(const S& c, HASH h, TIME a, TIME b, F&& out) {
+        if constexpr(requires { c.scan(h, a, b, out); })
+            c.scan(h, a, b, out);
+        else {
+            SERIES points = c.rebuild(h);
+            auto p = lower_bound(points.begin(), points.end(), a,
+                                 [](const pair<TIME, DATA>& p, TIME t) { return p.first < t; });
+            for(; p != points.end() && p->first <= b; p++)
+                out(p->first, p->second);
+        }
+    }
+    // values of every row for digest at the slots of [a, b], b - a < QUERY_BLOCK, into vals[t - a][row] as
+    // rebuild writes them; slots no saved counter covers keep 0 and have no bit in covered[row]
+    void query_rows(uint64_t digest, TIME a, TIME b, array<DATA, HEIGHT>* vals, bitset<QUERY_BLOCK>* covered) const {
+        assert(b - a < QUERY_BLOCK);
+        for(int row = 0; row < HEIGHT; row++) {
+            auto [rem, quo] = locate(digest, row);
+            auto& hc = history[row][rem];
+            for(auto c = first_history(hc, a); c != hc.end() && c->start() <= b; c++)
+                scan(*c, quo, a, b, [&](TIME t, DATA v) {
+                    vals[t - a][row] = v;
+                    covered[row].set(t - a);
+                });
+        }
+    }
 public:
     // reset all related data structures; act as an empty table afterward
-    virtual void reset() override {
-        derived_reset();
+    void reset() {
+        derived().derived_reset();
         for(auto& row : counters)
             for(auto& c : row)
                 c.reset();
@@ -80,41 +160,58 @@ public:
                 c.clear();
     }
     // return true if inserted successfully
-    virtual bool count(const five_tuple& f, TIME t, DATA c) override {
+    bool count(const five_tuple& f, TIME t, DATA c) {
+        return count(f.digest(), t, c);
+    }
+    bool count(uint64_t digest, TIME t, DATA c) {
         for(int row = 0; row < HEIGHT; row++) {
-            HASH h = f.hash(seeds[row]);
-            HASH rem = h % WIDTH;
-            HASH quo = h / WIDTH;
+            auto [rem, quo] = locate(digest, row);
             bool result = counters[row][rem].count(t, quo, c);
             if(result) {
-                save_counter(row, rem);
+                derived().save_counter(row, rem);
                 counters[row][rem].count(t, quo, c);
             }
         }
         return true;
     }
+    void prefetch(uint64_t digest) const {
+        for(int row = 0; row < HEIGHT; row++)
+            counters[row][locate(digest, row).first].prefetch();
+    }
+    // count a burst of packets in arrival order, hashing DIGEST_BATCH of them at once;
+    // counters of the packet PREFETCH_AHEAD places ahead are fetched while one is counted
+    void count_batch(span<const PACKET> batch) {
+        thread_local vector<uint64_t> digest;
+        digest.resize(ROUND_UP(batch.size(), DIGEST_BATCH));
+        for(size_t pos = 0; pos < batch.size(); pos += DIGEST_BATCH)
+            D::digest_packets(batch.subspan(pos, min<size_t>(DIGEST_BATCH, batch.size() - pos)), &digest[pos]);
+
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(i + PREFETCH_AHEAD < batch.size()) [[likely]]
+                derived().prefetch(digest[i + PREFETCH_AHEAD]);
+            derived().count(digest[i], get<1>(batch[i]), get<2>(batch[i]));
+        }
+    }
     // finish recording and deal with remaining buffered data
-    virtual void flush() override {
+    void flush() {
         for(int row = 0; row < HEIGHT; row++) {
             for(int col = 0; col < WIDTH; col++) {
                 if(counters[row][col].empty())
                     continue;
                 counters[row][col].flush();
-                save_counter(row, col);
+                derived().save_counter(row, col);
             }
         }
+        thaw_history();
     }
     // rebuild counters of five-tuple f in [start, last], inclusive
-    virtual STREAM_QUEUE rebuild(const five_tuple& f, TIME start, TIME last) const override {
-        vector<array<DATA, HEIGHT>> merger(last - start + 1);
-        for(auto& a : merger)
-            a.fill(0);
-        STREAM_QUEUE result(last - start + 1);
+    void rebuild(const five_tuple& f, TIME start, TIME last, span<pair<TIME, DATA>> out) const {
+        thread_local vector<array<DATA, HEIGHT>> merger;
+        merger.assign(last - start + 1, {});
 
+        uint64_t digest = f.digest();
         for(int row = 0; row < HEIGHT; row++) {
-            HASH h = f.hash(seeds[row]);
-            HASH rem = h % WIDTH;
-            HASH quo = h / WIDTH;
+            auto [rem, quo] = locate(digest, row);
 
             auto& hc = history[row][rem];
             for(auto c = first_history(hc, start); c != hc.end(); c++) {
@@ -128,14 +225,158 @@ public:
         }
 
         for(int pos = 0; pos <= last - start; pos++) {
-            result[pos].first = pos + start;
-            result[pos].second = select_val(merger[pos]);
+            out[pos].first = pos + start;
+            out[pos].second = derived().select_val(merger[pos]);
+        }
+    }
+    // rebuild every flow of dict over the span of its series, as rebuild does one by one. Flows are taken in runs of
+    // about REBUILD_SLOTS time slots and grouped by the cell they hash to in each row, so the history of a cell is
+    // walked once per run and, unless C is keyed, each saved counter is rebuilt once for all of its flows. Cells are
+    // spread over rebuild_pool; caches of saved counters are only touched by the task of their own cell
+    STREAM rebuild_all(const STREAM& dict) const {
+        struct query {
+            HASH col;
+            HASH quo;
+            uint32_t id;
+        };
+
+        STREAM result;
+        result.reserve(dict.size(), dict.slots());
+        vector<uint64_t> digests;
+        vector<TIME> starts, lasts;
+        // offsets[id] is the number of slots of the flows before id
+        vector<size_t> offsets{0};
+        digests.reserve(dict.size());
+        starts.reserve(dict.size());
+        lasts.reserve(dict.size());
+        offsets.reserve(dict.size() + 1);
+        for(auto [f, q] : dict) {
+            TIME start = q.front().first, last = q.back().first;
+            digests.push_back(f.digest());
+            starts.push_back(start);
+            lasts.push_back(last);
+            offsets.push_back(offsets.back() + last - start + 1);
+            result.allocate(f, last - start + 1);
         }
 
+        // cells of a run are rebuilt in parallel, each walking only its own history
+        struct cell {
+            int row;
+            uint32_t begin;
+            uint32_t end;
+        };
+        auto& pool = rebuild_pool();
+        thread_local vector<array<DATA, HEIGHT>> buffer;
+        auto& merger = buffer;
+        array<vector<query>, HEIGHT> queries;
+        vector<cell> cells;
+        for(uint32_t lo = 0, hi = 0; lo < dict.size(); lo = hi) {
+            while(hi < dict.size() && (hi == lo || offsets[hi + 1] - offsets[lo] <= REBUILD_SLOTS))
+                hi++;
+            merger.assign(offsets[hi] - offsets[lo], {});
+
+            pool.for_each(HEIGHT, [&](size_t row) {
+                auto& qs = queries[row];
+                qs.resize(hi - lo);
+                for(uint32_t id = lo; id < hi; id++) {
+                    auto [rem, quo] = locate(digests[id], row);
+                    qs[id - lo] = {rem, quo, id};
+                }
+                sort(qs.begin(), qs.end(), [&](const query& l, const query& r) {
+                    return l.col != r.col ? l.col < r.col : starts[l.id] < starts[r.id];
+                });
+            });
+            cells.clear();
+            for(int row = 0; row < HEIGHT; row++)
+                for(uint32_t begin = 0, end; begin < hi - lo; begin = end) {
+                    end = begin + 1;
+                    while(end < hi - lo && queries[row][end].col == queries[row][begin].col)
+                        end++;
+                    cells.push_back({row, begin, end});
+                }
+
+            pool.for_each(cells.size(), [&](size_t k) {
+                auto [row, begin, end] = cells[k];
+                auto group = queries[row].begin() + begin, group_end = queries[row].begin() + end;
+                auto& hc = history[row][group->col];
+                // flows of the cell overlapping c, admitted in start order and dropped once c is past them
+                thread_local vector<query> active;
+                active.clear();
+                auto next = group;
+                auto c = hc.begin();
+                while(true) {
+                    if(active.empty()) {
+                        if(next == group_end)
+                            break;
+                        c = first_history(hc, starts[next->id]);
+                    }
+                    if(c == hc.end())
+                        break;
+                    while(next != group_end && starts[next->id] < c->start() + MAX_LENGTH)
+                        active.push_back(*next++);
+                    erase_if(active, [&](const query& q) { return lasts[q.id] < c->start(); });
+
+                    SERIES points;
+                    bool built = false;
+                    for(auto& q : active) {
+                        if(keyed_rebuild<C> || !built) {
+                            points = c->rebuild(q.quo);
+                            built = true;
+                        }
+                        TIME start = starts[q.id];
+                        auto p = lower_bound(points.begin(), points.end(), start,
+                                             [](const pair<TIME, DATA>& p, TIME t) { return p.first < t; });
+                        auto merged = merger.begin() + (offsets[q.id] - offsets[lo]);
+                        for(; p != points.end() && p->first <= lasts[q.id]; p++)
+                            merged[p->first - start][row] = p->second;
+                    }
+                    c++;
+                }
+            });
+
+            pool.for_each(hi - lo, [&](size_t k) {
+                uint32_t id = lo + k;
+                auto out = result.at(id);
+                auto merged = merger.begin() + (offsets[id] - offsets[lo]);
+                for(size_t pos = 0; pos < out.size(); pos++) {
+                    out[pos].first = starts[id] + pos;
+                    out[pos].second = derived().select_val(merged[pos]);
+                }
+            });
+        }
+        return result;
+    }
+    // values of f at the slots of [a, b] as rebuild gives them, handed to out(t, value) in time order; saved counters
+    // are decoded over one block of [a, b] at a time where they can be, and nothing is kept for the whole span of f
+    template<typename F>
+    void query(const five_tuple& f, TIME a, TIME b, F&& out) const {
+        uint64_t digest = f.digest();
+        for_each_block(a, b, [&](TIME lo, TIME hi) {
+            array<array<DATA, HEIGHT>, QUERY_BLOCK> vals{};
+            array<bitset<QUERY_BLOCK>, HEIGHT> covered{};
+            query_rows(digest, lo, hi, vals.data(), covered.data());
+            for(TIME t = lo; t <= hi; t++)
+                out(t, derived().select_val(vals[t - lo]));
+        });
+    }
+    DATA query_point(const five_tuple& f, TIME t) const {
+        DATA result = 0;
+        derived().query(f, t, t, [&](TIME, DATA v) { result = v; });
         return result;
     }
+    int64_t query_sum(const five_tuple& f, TIME a, TIME b) const {
+        int64_t result = 0;
+        derived().query(f, a, b, [&](TIME, DATA v) { result += v; });
+        return result;
+    }
+    DATA query_max(const five_tuple& f, TIME a, TIME b) const {
+        DATA result = 0;
+        derived().query(f, a, b, [&](TIME, DATA v) { result = max(result, v); });
+        return result;
+    }
+
     // serialize all the historic counters
-    virtual size_t serialize() const override {
+    size_t serialize() const {
         size_t result = 0;
         for(int row = 0; row < HEIGHT; row++)
             for(int col = 0; col < WIDTH; col++) {
@@ -146,10 +387,43 @@ public:
             }
         return result;
     }
+    void serialize(bit_writer& out) const {
+        for(int row = 0; row < HEIGHT; row++)
+            for(int col = 0; col < WIDTH; col++) {
+                out.put(history[row][col].size());
+                for(auto& c : history[row][col])
+                    c.serialize(out);
+            }
+    }
+    void deserialize(bit_reader& in) {
+        reset();
+        for(int row = 0; row < HEIGHT; row++)
+            for(int col = 0; col < WIDTH; col++) {
+                auto n = in.get<size_t>();
+                for(size_t k = 0; k < n; k++)
+                    history[row][col].emplace_back().deserialize(in);
+            }
+        thaw_history();
+    }
 };
 
 template<typename T>
-concept DerivedTable = std::is_base_of_v<abstract_table, T>;
+concept DerivedTable = std::is_base_of_v<abstract_table, T> &&
+    requires(T t, const T& ct, const five_tuple& f, TIME time, DATA d, span<const PACKET> batch,
+             span<pair<TIME, DATA>> out, const STREAM& dict, bit_writer& w, bit_reader& r) {
+        t.reset();
+        t.count(f, time, d);
+        t.count_batch(batch);
+        t.flush();
+        ct.rebuild(f, time, time, out);
+        { ct.rebuild_all(dict) } -> std::same_as<STREAM>;
+        { ct.query_point(f, time) } -> std::same_as<DATA>;
+        { ct.query_sum(f, time, time) } -> std::same_as<int64_t>;
+        { ct.query_max(f, time, time) } -> std::same_as<DATA>;
+        { ct.serialize() } -> std::convertible_to<size_t>;
+        ct.serialize(w);
+        t.deserialize(r);
+    };
 
 
 #endif //TABLE_H
@@ -0,0 +1,81 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+/* fixed-size pool of worker threads; with a single thread, tasks run inline on submit */
+class thread_pool {
+protected:
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex lock;
+    condition_variable ready;
+    bool stopped = false;
+
+    void work() {
+        while(true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [this] { return stopped || !tasks.empty(); });
+                if(tasks.empty())
+                    return;
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+public:
+    // n = 0 for hardware concurrency
+    explicit thread_pool(unsigned n = 0) {
+        if(n == 0)
+            n = max(1u, thread::hardware_concurrency());
+        if(n > 1)
+            for(unsigned i = 0; i < n; i++)
+                workers.emplace_back([this] { work(); });
+    }
+    ~thread_pool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopped = true;
+        }
+        ready.notify_all();
+        for(auto& w : workers)
+            w.join();
+    }
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const {
+        return max<size_t>(1, workers.size());
+    }
+
+    template<typename F>
+    future<invoke_result_t<F>> submit(F&& f) {
+        auto task = make_shared<packaged_task<invoke_result_t<F>()>>(forward<F>(f));
+        auto result = task->get_future();
+        if(workers.empty()) {
+            (*task)();
+            return result;
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            tasks.emplace_back([task] { (*task)(); });
+        }
+        ready.notify_one();
+        return result;
+    }
+};
+
+#endif //THREAD_POOL_H
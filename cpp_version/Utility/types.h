@@ -6,6 +6,9 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <deque>
+#include <span>
+#include <tuple>
+#include <vector>
 
 #include "five_tuple.h"
 
@@ -17,8 +20,12 @@ typedef size_t HASH;
 typedef uint8_t BYTE;
 
 typedef unordered_set<five_tuple> LABELS;
-typedef deque<pair<TIME, DATA>> STREAM_QUEUE;
-typedef unordered_map<five_tuple, STREAM_QUEUE> STREAM;
-typedef deque<tuple<five_tuple, TIME, DATA>> SORTED;
+typedef span<const pair<TIME, DATA>> SERIES;
+class flow_table;
+typedef flow_table STREAM;
+typedef tuple<five_tuple, TIME, DATA> PACKET;
+typedef vector<PACKET> SORTED;
+
+#include "flow_table.h"
 
 #endif //TYPES_H
@@ -0,0 +1,175 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* fork-join pool for parallel loops. The indices of a loop are split in one range per participant, the workers and
+ * the calling thread; each takes indices from the front of its own range and, once it is empty, steals the back half
+ * of the largest other range. Callers take part in their own loops, so loops may be nested or started from several
+ * threads at once; with a single thread, loops run inline */
+class work_pool {
+protected:
+    // [begin, end) in one word, so that taking and stealing are single compare-exchanges
+    struct alignas(64) range {
+        atomic<uint64_t> bounds{0};
+    };
+    static uint64_t pack(uint32_t begin, uint32_t end) {
+        return uint64_t(end) << 32 | begin;
+    }
+    static uint32_t begin_of(uint64_t r) {
+        return uint32_t(r);
+    }
+    static uint32_t end_of(uint64_t r) {
+        return uint32_t(r >> 32);
+    }
+
+    struct job {
+        const function<void(size_t)>& body;
+        vector<range> ranges;
+        // indices not yet run, and workers holding the job
+        atomic<size_t> left;
+        unsigned users = 0;
+        bool listed = true;
+
+        job(const function<void(size_t)>& body, size_t n, size_t parts) : body(body), ranges(parts), left(n) {
+            for(size_t k = 0; k < parts; k++)
+                ranges[k].bounds.store(pack(n * k / parts, n * (k + 1) / parts), memory_order_relaxed);
+        }
+    };
+
+    vector<thread> workers;
+    // jobs with indices left to take
+    vector<job*> jobs;
+    mutex lock;
+    condition_variable ready, finished;
+    bool stopped = false;
+
+    static bool take(range& r, size_t& index) {
+        uint64_t old = r.bounds.load(memory_order_relaxed);
+        while(begin_of(old) < end_of(old))
+            if(r.bounds.compare_exchange_weak(old, pack(begin_of(old) + 1, end_of(old)))) {
+                index = begin_of(old);
+                return true;
+            }
+        return false;
+    }
+    // move the back half of the largest other range to the empty range of slot
+    static bool steal(job& j, size_t slot) {
+        while(true) {
+            size_t victim = slot;
+            uint64_t old = 0;
+            for(size_t k = 0; k < j.ranges.size(); k++) {
+                uint64_t r = j.ranges[k].bounds.load(memory_order_relaxed);
+                if(k != slot && end_of(r) - begin_of(r) > end_of(old) - begin_of(old)) {
+                    victim = k;
+                    old = r;
+                }
+            }
+            if(victim == slot)
+                return false;
+            uint32_t mid = begin_of(old) + (end_of(old) - begin_of(old)) / 2;
+            if(j.ranges[victim].bounds.compare_exchange_strong(old, pack(begin_of(old), mid))) {
+                j.ranges[slot].bounds.store(pack(mid, end_of(old)));
+                return true;
+            }
+        }
+    }
+    void run(job& j, size_t slot) {
+        size_t index;
+        while(true) {
+            if(!take(j.ranges[slot], index)) {
+                // what was stolen may be stolen again before it is taken
+                if(steal(j, slot))
+                    continue;
+                break;
+            }
+            j.body(index);
+            if(j.left.fetch_sub(1) == 1) {
+                lock_guard<mutex> guard(lock);
+                finished.notify_all();
+            }
+        }
+        // nothing is left to take, so no one else needs to enter the job
+        lock_guard<mutex> guard(lock);
+        if(j.listed) {
+            erase(jobs, &j);
+            j.listed = false;
+        }
+    }
+    void work(size_t slot) {
+        while(true) {
+            job* j;
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [this] { return stopped || !jobs.empty(); });
+                if(jobs.empty())
+                    return;
+                j = jobs.front();
+                j->users++;
+            }
+            run(*j, slot);
+            {
+                lock_guard<mutex> guard(lock);
+                j->users--;
+            }
+            finished.notify_all();
+        }
+    }
+public:
+    // n = 0 for hardware concurrency
+    explicit work_pool(unsigned n = 0) {
+        if(n == 0)
+            n = max(1u, thread::hardware_concurrency());
+        if(n > 1)
+            for(unsigned i = 0; i + 1 < n; i++)
+                workers.emplace_back([this, i] { work(i); });
+    }
+    ~work_pool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopped = true;
+        }
+        ready.notify_all();
+        for(auto& w : workers)
+            w.join();
+    }
+    work_pool(const work_pool&) = delete;
+    work_pool& operator=(const work_pool&) = delete;
+
+    // threads taking part in a loop, the caller included
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    // run f(i) for every i in [0, n) and return once all have finished
+    template<typename F>
+    void for_each(size_t n, F&& f) {
+        if(workers.empty() || n <= 1) {
+            for(size_t i = 0; i < n; i++)
+                f(i);
+            return;
+        }
+        assert(n <= UINT32_MAX);
+        function<void(size_t)> body(ref(f));
+        job j(body, n, size());
+        {
+            lock_guard<mutex> guard(lock);
+            jobs.push_back(&j);
+        }
+        ready.notify_all();
+        run(j, workers.size());
+
+        unique_lock<mutex> guard(lock);
+        finished.wait(guard, [&j] { return j.left == 0 && j.users == 0; });
+    }
+};
+
+#endif //WORK_POOL_H
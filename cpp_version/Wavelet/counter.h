@@ -2,6 +2,7 @@
 #define WAVELET_COUNTER_H
 
 #include "../Utility/headers.h"
+#include "../Utility/haar.h"
 #include "interval.h"
 #include "record.h"
 
@@ -9,11 +10,15 @@ using namespace std;
 
 namespace Wavelet {
 
-    typedef STREAM_QUEUE::const_iterator SQptr;
+    typedef SERIES::iterator SQptr;
     typedef uint16_t DATA16;
 
+    template<bool BY_THRESHOLD>
+    class sealed;
+
     template<bool BY_THRESHOLD = false>
     class counter : public abstract_counter {
+        friend class sealed<BY_THRESHOLD>;
     protected:
 #ifdef BY_BYTES
         constexpr static const int SCALE = 1000;
@@ -34,7 +39,7 @@ namespace Wavelet {
         heap<record, DEPTH> detail{};
         pseudo_heap<record, T_DEPTH> th_detail[2]{};
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
 
         static DATA truncate(DATA d) {
             return d / SCALE + (SCALE > 1 && d % SCALE >= SCALE / 2);
@@ -68,17 +73,108 @@ namespace Wavelet {
             heap_insert(level, hi);
             return lo;
         }
-        static void inverse_transform(DATA& lo, DATA& hi) {
-            DATA l = (lo + hi) / 2;
-            DATA h = (lo - hi) / 2;
-            lo = l;
-            hi = h;
+        // place the coefficients over the details in temp and inverse-transform the window in place
+        static void inverse_raw(TIME_DIFF elapse, const array<DATA16, LEVEL>& last_coef,
+                                const array<DATA16, RESERVED>& top_level, vector<DATA>& temp) {
+            // copy top level
+            for(int i = 0; i < elapse >> LEVEL; i++)
+                temp[i << LEVEL] = recover(top_level[i]);
+
+            // copy data yet to be transformed
+            bitset<16> mask{elapse};
+            for(int i = 0; i < LEVEL; i++)
+                if(mask[i])
+                    temp[(elapse >> (i + 1)) << (i + 1)] = recover(last_coef[i]);
+
+            // inverse-transform section by section, the last one only over its complete blocks
+            for(uint32_t frag = 0; frag < elapse; frag += 1 << LEVEL)
+                inverse_haar(&temp[frag], min<uint32_t>(1 << LEVEL, elapse - frag), LEVEL);
+        }
+        // inverse-transform the window as inverse_raw does and write it to cache, empty points raised to SCALE
+        static void inverse_window(TIME start_time, TIME_DIFF elapse, const array<DATA16, LEVEL>& last_coef,
+                                   const array<DATA16, RESERVED>& top_level, vector<DATA>& temp,
+                                   vector<pair<TIME, DATA>>& cache) {
+            inverse_raw(elapse, last_coef, top_level, temp);
+
+            // copy from temp to result
+            cache.resize(elapse);
+            for(int pos = 0; pos < elapse; pos++) {
+                cache[pos].first = start_time + pos;
+                cache[pos].second = temp[pos] > 0 ? temp[pos] : SCALE;
+            }
+        }
+        /* hand the points of a window within [a, b] to out(t, value) in time order, as inverse_window would write
+         * them, decoding only the coefficients on the way from each root to those points; placed holds the details
+         * in the order rebuild places them in temp, so the last one at a position wins */
+        template<typename F>
+        static void scan_window(TIME start_time, TIME_DIFF elapse, const array<DATA16, LEVEL>& last_coef,
+                                const array<DATA16, RESERVED>& top_level, span<const record> placed,
+                                TIME a, TIME b, F&& out) {
+            if(b < start_time || a >= start_time + elapse)
+                return;
+            uint32_t lo = max(a, start_time) - start_time, hi = min<TIME>(b, start_time + elapse - 1) - start_time;
+
+            thread_local vector<pair<uint16_t, DATA>> details;
+            details.clear();
+            for(auto& r : placed)
+                details.emplace_back(r.pos, recover(r.data()));
+            stable_sort(details.begin(), details.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+            auto detail_at = [](uint32_t pos) {
+                auto it = upper_bound(details.begin(), details.end(), pos,
+                                      [](uint32_t p, const auto& d) { return p < d.first; });
+                return it != details.begin() && prev(it)->first == pos ? prev(it)->second : 0;
+            };
+            // the block of 2^level points at base, whose lowest coefficient is v, overlaps [lo, hi]
+            auto descend = [&](auto& self, uint32_t base, int level, DATA v) -> void {
+                if(level == 0) {
+                    out(start_time + base, v > 0 ? v : SCALE);
+                    return;
+                }
+                uint32_t half = 1u << (level - 1);
+                DATA d = detail_at(base + half);
+                if(lo < base + half)
+                    self(self, base, level - 1, (v + d) / 2);
+                if(hi >= base + half)
+                    self(self, base + half, level - 1, (v - d) / 2);
+            };
+
+            // whole sections are rooted at top-level coefficients, the complete blocks of the last one at the
+            // coefficients yet to be transformed
+            for(uint32_t section = lo >> LEVEL << LEVEL; section <= hi; section += 1 << LEVEL) {
+                if(section + (1 << LEVEL) <= elapse) {
+                    descend(descend, section, LEVEL, recover(top_level[section >> LEVEL]));
+                    continue;
+                }
+                for(int k = LEVEL - 1; k >= 0; k--) {
+                    uint32_t base = (elapse >> (k + 1)) << (k + 1);
+                    if((elapse >> k) & 1 && base <= hi && base + (1u << k) > lo)
+                        descend(descend, base, k, recover(last_coef[k]));
+                }
+            }
+        }
+        // subtract the points of a precisely-recorded flow from a rebuilt window
+        static SQptr subtract_from(vector<pair<TIME, DATA>>& cache, SQptr it, const SQptr& end) {
+            auto cache_it = upper_bound(cache.begin(), cache.end(), it->first,
+                                        [](const TIME& t, const auto& p) { return t <= p.first; });
+            while(it != end && cache_it != cache.end()) {
+                if(it->first > cache_it->first)
+                    cache_it++;
+                else if(it->first < cache_it->first)
+                    it++;
+                else [[likely]] {
+                    cache_it->second -= it->second;
+                    it++;
+                    cache_it++;
+                }
+            }
+
+            return it;
         }
     public:
         uint16_t get_count() const {
             return elapse;
         }
-        void reset() override {
+        void reset() {
             start_time = 0;
             elapse = 0;
             value = 0;
@@ -93,10 +189,24 @@ namespace Wavelet {
             cache.clear();
         }
 
-        bool count(TIME t, HASH, DATA c) override {
+        void prefetch() const {
+            __builtin_prefetch(this, 1);
+            if(BY_THRESHOLD) {
+                th_detail[0].prefetch();
+                th_detail[1].prefetch();
+            } else
+                detail.prefetch();
+        }
+
+        bool count(TIME t, HASH h, DATA c) {
             assert(t >= start_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
+                // evictions of a window depend only on the packets counted into it
+                if(BY_THRESHOLD) {
+                    th_detail[0].seed(0xAEABDC85u ^ (t * 0x9E3779B1u) ^ h);
+                    th_detail[1].seed(0x85EBCA6Bu ^ (t * 0x9E3779B1u) ^ h);
+                }
             } else if(t - start_time >= MAX_LENGTH) [[unlikely]] {
                 flush();
                 return true;
@@ -111,7 +221,7 @@ namespace Wavelet {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
 
@@ -163,16 +273,26 @@ namespace Wavelet {
             value = 0;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
+        SERIES rebuild(HASH) const {
             // parameter has no use here
             assert(!empty());
             if(!cache.empty())
                 return cache;
 
-            cache.resize(elapse);
-
-            vector<DATA> temp(elapse, 0);
-            // copy heap data
+            thread_local vector<DATA> temp;
+            place_details(temp);
+            inverse_window(start_time, elapse, last_coef, top_level, temp, cache);
+            return cache;
+        }
+        // the points of the window before empty ones are raised to SCALE, from start() on
+        void rebuild_raw(vector<DATA>& temp) const {
+            assert(!empty());
+            place_details(temp);
+            inverse_raw(elapse, last_coef, top_level, temp);
+        }
+        // the details at their positions in a window of zeros, in the order rebuild places them
+        void place_details(vector<DATA>& temp) const {
+            temp.assign(elapse, 0);
             if(BY_THRESHOLD) {
                 for(auto& d : th_detail)
                     for(int i = 0; i < d.size_hi; i++) {
@@ -190,40 +310,6 @@ namespace Wavelet {
                     int pos = detail.heap_data[i].pos;
                     temp[pos] = recover(detail.heap_data[i].data());
                 }
-
-            // copy top level
-            for(int i = 0; i < elapse >> LEVEL; i++)
-                temp[i << LEVEL] = recover(top_level[i]);
-
-            // copy data yet to be transformed
-            bitset<16> mask{elapse};
-            for(int i = 0; i < LEVEL; i++)
-                if(mask[i])
-                    temp[(elapse >> (i + 1)) << (i + 1)] = recover(last_coef[i]);
-
-            // inverse-transform each section except for the last one
-            uint16_t last_section = (elapse >> LEVEL) << LEVEL;
-            for(uint32_t frag = 0; frag < last_section; frag += 1 << LEVEL) {
-                for(uint32_t p = 1 << LEVEL; p > 0; p--) {
-                    uint32_t pos = frag + p;
-                    for(int i = countr_zero(p) - 1; i >= 0; i--) {
-                        inverse_transform(temp[pos - (2 << i)], temp[pos - (1 << i)]);
-                    }
-                }
-            }
-
-            // inverse-transform the last section
-            for(uint32_t pos = elapse; pos > last_section; pos--)
-                for(int i = countr_zero(pos) - 1; i >= 0; i--)
-                    inverse_transform(temp[pos - (2 << i)], temp[pos - (1 << i)]);
-
-            // copy from temp to result
-            for(int pos = 0; pos < elapse; pos++) {
-                cache[pos].first = start_time + pos;
-                cache[pos].second = temp[pos] > 0 ? temp[pos] : SCALE;
-            }
-
-            return cache;
         }
 
         // given a precisely-recorded flow, subtract its value from every recorded time-window
@@ -232,33 +318,68 @@ namespace Wavelet {
             if(cache.empty()) [[unlikely]] {
                 rebuild(h);
             }
+            return subtract_from(cache, it, end);
+        }
 
-            auto cache_it = upper_bound(cache.begin(), cache.end(), it->first,
-                                        [](const TIME& t, const auto& p) { return t <= p.first; });
-            while(it != end && cache_it != cache.end()) {
-                if(it->first > cache_it->first)
-                    cache_it++;
-                else if(it->first < cache_it->first)
-                    it++;
-                else [[likely]] {
-                    cache_it->second -= it->second;
-                    it++;
-                    cache_it++;
-                }
-            }
+        // add a counter of the same start time coefficient by coefficient; details at the same
+        // position are summed and the largest of them are selected again by record order
+        void merge(const counter& other) {
+            assert(start_time == other.start_time && !empty());
+            counter rhs = other;
+            if(elapse < rhs.elapse)
+                align(start_time + rhs.elapse);
+            else if(rhs.elapse < elapse)
+                rhs.align(start_time + elapse);
+
+            for(int l = 0; l < LEVEL; l++)
+                if((elapse >> l) & 1)
+                    last_coef[l] = adds(last_coef[l], rhs.last_coef[l]);
+            for(int i = 0; i < (elapse >> LEVEL); i++)
+                top_level[i] = adds(top_level[i], rhs.top_level[i]);
+            value = adds(value, rhs.value);
+
+            map<uint16_t, DATA> details;
+            auto collect = [&](const counter& c) {
+                if(BY_THRESHOLD) {
+                    for(auto& d : c.th_detail) {
+                        for(int i = 0; i < d.size_hi; i++)
+                            details[d.heap_data[i].pos] += d.heap_data[i].data();
+                        for(int i = T_DEPTH - 1; i > d.size_lo; i--)
+                            details[d.heap_data[i].pos] += d.heap_data[i].data();
+                    }
+                } else
+                    for(int i = 0; i < c.detail.size; i++)
+                        details[c.detail.heap_data[i].pos] += c.detail.heap_data[i].data();
+            };
+            collect(*this);
+            collect(rhs);
 
-            return it;
+            if(BY_THRESHOLD) {
+                th_detail[0].reset();
+                th_detail[1].reset();
+            } else
+                detail.reset();
+            for(auto [pos, d] : details) {
+                if(d == 0)
+                    continue;
+                record r(pos, d);
+                if(BY_THRESHOLD)
+                    th_detail[r.level() % 2].insert(r);
+                else
+                    detail.insert(r);
+            }
+            cache.clear();
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             result += sizeof(start_time);
             result += sizeof(elapse);
@@ -271,6 +392,35 @@ namespace Wavelet {
                 result += detail.serialize();
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            out.put(elapse);
+            for(int l = 0; l < LEVEL; l++)
+                if((elapse >> l) & 1)
+                    out.put(last_coef[l]);
+            for(int i = 0; i < min<int>(RESERVED, elapse >> LEVEL); i++)
+                out.put(top_level[i]);
+            if(BY_THRESHOLD) {
+                th_detail[0].serialize(out);
+                th_detail[1].serialize(out);
+            } else
+                detail.serialize(out);
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            elapse = in.get<TIME_DIFF>();
+            for(int l = 0; l < LEVEL; l++)
+                if((elapse >> l) & 1)
+                    last_coef[l] = in.get<DATA16>();
+            for(int i = 0; i < min<int>(RESERVED, elapse >> LEVEL); i++)
+                top_level[i] = in.get<DATA16>();
+            if(BY_THRESHOLD) {
+                th_detail[0].deserialize(in);
+                th_detail[1].deserialize(in);
+            } else
+                detail.deserialize(in);
+        }
 
         record list_min() const {
             return detail.heap_data[0];
@@ -279,8 +429,215 @@ namespace Wavelet {
         bool heap_full() const {
             return detail.size == DEPTH;
         }
+
+        // history keeps saved windows sealed
+        typedef sealed<BY_THRESHOLD> sealed_type;
     };
 
+    /* a saved window in compact form: the header, the coefficients and only the populated details, which keep
+     * the order they are encoded in, so that a sealed window encodes exactly as the counter it was sealed from
+     * and the first detail of a full heap is still its minimum */
+    template<bool BY_THRESHOLD>
+    class sealed {
+    protected:
+        typedef counter<BY_THRESHOLD> C;
+
+        TIME start_time{};
+        TIME_DIFF elapse{};
+        // details in the upper and the lower part of each pseudo heap of practical counters
+        uint8_t parts[2][2]{};
+        array<DATA16, LEVEL> last_coef{};
+        array<DATA16, RESERVED> top_level{};
+        vector<record> details{};
+
+        mutable vector<pair<TIME, DATA>> cache{};
+    public:
+        sealed() = default;
+        explicit sealed(const C& c) {
+            seal(c);
+        }
+        // take over a flushed counter; storage for details is reused
+        void seal(const C& c) {
+            start_time = c.start_time;
+            elapse = c.elapse;
+            last_coef = c.last_coef;
+            top_level = c.top_level;
+            details.clear();
+            if(BY_THRESHOLD)
+                for(int k = 0; k < 2; k++) {
+                    auto& d = c.th_detail[k];
+                    parts[k][0] = d.size_hi;
+                    parts[k][1] = C::T_DEPTH - 1 - d.size_lo;
+                    details.insert(details.end(), d.heap_data, d.heap_data + d.size_hi);
+                    for(int i = C::T_DEPTH - 1; i > d.size_lo; i--)
+                        details.push_back(d.heap_data[i]);
+                }
+            else
+                details.assign(c.detail.heap_data, c.detail.heap_data + c.detail.size);
+            cache.clear();
+        }
+        // a counter that rebuilds and encodes the same
+        C unseal() const {
+            bit_writer out;
+            serialize(out);
+            bit_reader in(out.data());
+            C result;
+            result.deserialize(in);
+            return result;
+        }
+
+        void reset() {
+            start_time = 0;
+            elapse = 0;
+            details.clear();
+            cache.clear();
+        }
+        bool empty() const {
+            return start_time == 0;
+        }
+        TIME start() const {
+            return start_time;
+        }
+
+        SERIES rebuild(HASH) const {
+            assert(!empty());
+            if(!cache.empty())
+                return cache;
+
+            thread_local vector<DATA> temp;
+            temp.assign(elapse, 0);
+            for(auto& r : details)
+                temp[r.pos] = C::recover(r.data());
+            C::inverse_window(start_time, elapse, last_coef, top_level, temp, cache);
+            return cache;
+        }
+        // the points of the window within [a, b] from its coefficients, without rebuilding it
+        template<typename F>
+        void scan(HASH, TIME a, TIME b, F&& out) const {
+            assert(!empty());
+            C::scan_window(start_time, elapse, last_coef, top_level, details, a, b, out);
+        }
+        SQptr subtract(HASH h, SQptr it, const SQptr& end) const {
+            assert(!empty());
+            if(cache.empty()) [[unlikely]]
+                rebuild(h);
+            return C::subtract_from(cache, it, end);
+        }
+
+        record list_min() const {
+            return details[0];
+        }
+        bool heap_full() const {
+            return !BY_THRESHOLD && details.size() == C::DEPTH;
+        }
+
+        size_t serialize() const {
+            size_t result = 0;
+            result += sizeof(start_time);
+            result += sizeof(elapse);
+            result += sizeof(DATA16) * popcount(elapse & INDEX_MASK);
+            result += sizeof(DATA16) * min<uint32_t>(RESERVED, elapse >> LEVEL);
+            result += sizeof(uint16_t) * (BY_THRESHOLD ? 2 : 1);
+            for(auto& r : details)
+                result += r.serialize();
+            return result;
+        }
+        void serialize(bit_writer& out) const {
+            out.put(start_time);
+            out.put(elapse);
+            for(int l = 0; l < LEVEL; l++)
+                if((elapse >> l) & 1)
+                    out.put(last_coef[l]);
+            for(int i = 0; i < min<int>(RESERVED, elapse >> LEVEL); i++)
+                out.put(top_level[i]);
+            auto r = details.begin();
+            if(BY_THRESHOLD)
+                for(auto& [hi, lo] : parts) {
+                    out.write(hi, 8);
+                    out.write(lo, 8);
+                    for(int i = 0; i < hi + lo; i++)
+                        (r++)->serialize(out);
+                }
+            else {
+                out.put(uint16_t(details.size()));
+                for(; r != details.end(); r++)
+                    r->serialize(out);
+            }
+        }
+        void deserialize(bit_reader& in) {
+            reset();
+            start_time = in.get<TIME>();
+            elapse = in.get<TIME_DIFF>();
+            for(int l = 0; l < LEVEL; l++)
+                if((elapse >> l) & 1)
+                    last_coef[l] = in.get<DATA16>();
+            for(int i = 0; i < min<int>(RESERVED, elapse >> LEVEL); i++)
+                top_level[i] = in.get<DATA16>();
+            if(BY_THRESHOLD)
+                for(auto& [hi, lo] : parts) {
+                    hi = in.read(8);
+                    lo = in.read(8);
+                    for(int i = 0; i < hi + lo; i++)
+                        details.emplace_back().deserialize(in);
+                }
+            else {
+                details.resize(in.get<uint16_t>());
+                for(auto& r : details)
+                    r.deserialize(in);
+            }
+        }
+    };
+
+    // merge the windows of from into the windows of into, both in time order without overlap;
+    // windows of the same start are merged in place, other overlapping windows are summed
+    // in the time domain before empty points are raised, and counted again
+    template<bool BY_THRESHOLD>
+    void merge_history(deque<counter<BY_THRESHOLD>>& into, const deque<counter<BY_THRESHOLD>>& from) {
+        typedef counter<BY_THRESHOLD> C;
+        if(from.empty())
+            return;
+        vector<C> windows(make_move_iterator(into.begin()), make_move_iterator(into.end()));
+        windows.insert(windows.end(), from.begin(), from.end());
+        stable_sort(windows.begin(), windows.end(), [](const C& l, const C& r) { return l.start() < r.start(); });
+        into.clear();
+
+        for(size_t i = 0, j; i < windows.size(); i = j) {
+            TIME first = windows[i].start(), last = first + windows[i].get_count();
+            bool aligned = true;
+            for(j = i + 1; j < windows.size() && windows[j].start() < last; j++) {
+                last = max<TIME>(last, windows[j].start() + windows[j].get_count());
+                aligned &= windows[j].start() == first;
+            }
+
+            if(aligned) {
+                for(size_t k = i + 1; k < j; k++)
+                    windows[i].merge(windows[k]);
+                into.push_back(move(windows[i]));
+                continue;
+            }
+
+            vector<DATA> sum(last - first, 0), raw;
+            for(size_t k = i; k < j; k++) {
+                windows[k].rebuild_raw(raw);
+                for(size_t pos = 0; pos < raw.size(); pos++)
+                    sum[windows[k].start() - first + pos] += raw[pos];
+            }
+            C c{};
+            for(TIME t = first; t < last; t++) {
+                if(sum[t - first] <= 0)
+                    continue;
+                if(c.count(t, 0, sum[t - first])) {
+                    into.push_back(c);
+                    c.reset();
+                    c.count(t, 0, sum[t - first]);
+                }
+            }
+            c.flush();
+            if(!c.empty())
+                into.push_back(move(c));
+        }
+    }
+
 } // Wavelet
 
 #endif //WAVELET_COUNTER_H
@@ -8,33 +8,45 @@ using namespace std;
 
 namespace Wavelet {
 
-    template<bool BY_THRESHOLD = false>
-    class heavy : public basic_table<counter<BY_THRESHOLD>, HALF_WIDTH, PAIR_HEIGHT> {
+    template<bool BY_THRESHOLD = false, uint32_t W = HALF_WIDTH>
+    class heavy : public basic_table<heavy<BY_THRESHOLD, W>, counter<BY_THRESHOLD>, W, PAIR_HEIGHT> {
+        friend class basic_table<heavy, counter<BY_THRESHOLD>, W, PAIR_HEIGHT>;
     protected:
-        constexpr static const HASH seed = heavy::seeds[heavy::HEIGHT];
-        static_assert(sizeof(heavy::seeds) / sizeof(HASH) >= heavy::HEIGHT + 1);
+        // labels are placed by a row of their own, after the rows of counters
+        constexpr static const HASH LABEL_ROW = heavy::HEIGHT;
 
         uint32_t frequency[heavy::HEIGHT][heavy::WIDTH]{};
+        // digest of each label, compared before the label itself
+        uint64_t fingerprint[heavy::HEIGHT][heavy::WIDTH]{};
         five_tuple label[heavy::HEIGHT][heavy::WIDTH]{};
+        // label of every window in the history of a cell, in the same order
         deque<five_tuple> history_label[heavy::HEIGHT][heavy::WIDTH]{};
 
-        void derived_reset() override {
+        void derived_reset() {
             memset(frequency, 0, sizeof(frequency));
             memset(label, 0, sizeof(label));
+            for(auto& row : fingerprint)
+                fill(begin(row), end(row), five_tuple{}.digest());
             for(auto& row : history_label)
                 for(auto& c : row)
                     c.clear();
         }
-        void save_counter(HASH row, HASH col) override {
+        // label the window just pushed to the history of a cell; labels of windows the history has dropped
+        // with HISTORY_RETENTION go with them
+        void push_label(HASH row, HASH col, const five_tuple& f) {
+            auto& hl = history_label[row][col];
+            hl.push_back(f);
+            while(hl.size() > heavy::history[row][col].size())
+                hl.pop_front();
+        }
+        void save_counter(HASH row, HASH col) {
             auto& c = heavy::counters[row][col];
             auto& hc = heavy::history[row][col];
-            auto& l = label[row][col];
-            auto& hl = history_label[row][col];
 
             c.flush();
             hc.push_back(c);
             c.reset();
-            hl.push_back(l);
+            push_label(row, col, label[row][col]);
         }
         void evict(HASH row, HASH col) {
             auto& c = heavy::counters[row][col];
@@ -44,14 +56,25 @@ namespace Wavelet {
                 c.reset();
         }
     public:
-        bool count(const five_tuple& f, TIME t, DATA c) override {
-            HASH h = f.hash(seed);
-            HASH rem = h % heavy::WIDTH;
-            HASH quo = h / heavy::WIDTH;
+        // labels, frequencies and counters of every row in the column of a digest
+        void prefetch(uint64_t digest) const {
+            HASH rem = heavy::locate(digest, LABEL_ROW).first;
+            for(int row = 0; row < heavy::HEIGHT; row++) {
+                __builtin_prefetch(&fingerprint[row][rem]);
+                __builtin_prefetch(&frequency[row][rem], 1);
+                heavy::counters[row][rem].prefetch();
+            }
+        }
+
+        bool count(const five_tuple& f, TIME t, DATA c) {
+            return count(f, f.digest(), t, c);
+        }
+        bool count(const five_tuple& f, uint64_t digest, TIME t, DATA c) {
+            auto [rem, quo] = heavy::locate(digest, LABEL_ROW);
             HASH row;
             // search f in existing labels
             for(row = 0; row < heavy::HEIGHT; row++)
-                if(label[row][rem] == f)
+                if(fingerprint[row][rem] == digest && label[row][rem] == f)
                     break;
 
             if(row == heavy::HEIGHT) {
@@ -62,6 +85,7 @@ namespace Wavelet {
                         // eviction happens
                         evict(row, rem);
                         label[row][rem] = f;
+                        fingerprint[row][rem] = digest;
                         break;
                     }
                 }
@@ -81,10 +105,11 @@ namespace Wavelet {
             }
         }
 
-        STREAM_QUEUE rebuild(const five_tuple& f, TIME, TIME) const override {
+        // append recorded data of five-tuple f to out in time order
+        void rebuild(const five_tuple& f, vector<pair<TIME, DATA>>& out) const {
             map<TIME, DATA> merger;
             // search f in existing labels
-            HASH col = f.hash(seed) % heavy::WIDTH;
+            HASH col = heavy::locate(f.digest(), LABEL_ROW).first;
             HASH row;
             for(row = 0; row < heavy::HEIGHT; row++) {
                 auto& hl = history_label[row][col];
@@ -98,12 +123,166 @@ namespace Wavelet {
                 }
             }
 
-            STREAM_QUEUE result;
             for(auto& p : merger)
-                result.emplace_back(p.first, p.second);
+                out.emplace_back(p.first, p.second);
+        }
+        // the recorded data of every flow of dict found here; a flow is only searched in the column of its label,
+        // so columns are rebuilt in parallel
+        STREAM rebuild_all(const STREAM& dict) const {
+            vector<vector<uint32_t>> columns(heavy::WIDTH);
+            for(uint32_t id = 0; id < dict.size(); id++)
+                columns[heavy::locate(dict.label(id).digest(), LABEL_ROW).first].push_back(id);
+            vector<vector<pair<TIME, DATA>>> found(dict.size());
+            rebuild_pool().for_each(heavy::WIDTH, [&](size_t col) {
+                for(auto id : columns[col])
+                    rebuild(dict.label(id), found[id]);
+            });
+
+            STREAM result;
+            for(uint32_t id = 0; id < dict.size(); id++)
+                if(!found[id].empty())
+                    result.assign(dict.label(id), found[id]);
+            return result;
+        }
+
+        // a recorded point of a flow, as rebuild gives it
+        struct point {
+            five_tuple f;
+            uint64_t digest;
+            TIME t;
+            DATA value;
+        };
+        // recorded points in [a, b] of every label whose digest passes want, handed to out(lo, hi, points) block by
+        // block, label by label and in time order within a label. Windows are chosen once for all blocks; those of a
+        // label are decoded in the order rebuild merges them, so the last one at a time slot wins
+        template<typename P, typename F>
+        void query(TIME a, TIME b, P&& want, F&& out) const {
+            struct window {
+                const five_tuple* f;
+                uint64_t digest;
+                const sealed<BY_THRESHOLD>* c;
+                HASH row;
+            };
+            // merged histories are grouped by label rather than time, so every window is looked at
+            vector<window> found;
+            for(int row = 0; row < heavy::HEIGHT; row++)
+                for(int col = 0; col < heavy::WIDTH; col++) {
+                    auto& hl = history_label[row][col];
+                    auto& hc = heavy::history[row][col];
+                    for(size_t k = 0; k < hc.size(); k++) {
+                        if(hc[k].start() > b || hc[k].start() + MAX_LENGTH <= a)
+                            continue;
+                        uint64_t digest = hl[k].digest();
+                        if(want(digest))
+                            found.push_back({&hl[k], digest, &hc[k], HASH(row)});
+                    }
+                }
+            stable_sort(found.begin(), found.end(), [](const window& l, const window& r) { return *l.f < *r.f; });
+
+            vector<point> points;
+            for_each_block(a, b, [&](TIME lo, TIME hi) {
+                points.clear();
+                for(auto w = found.begin(); w != found.end();) {
+                    auto e = find_if(w, found.end(), [&](const window& x) { return *x.f != *w->f; });
+                    array<DATA, QUERY_BLOCK> vals;
+                    bitset<QUERY_BLOCK> covered;
+                    for(auto x = w; x != e; x++)
+                        heavy::scan(*x->c, x->row, lo, hi, [&](TIME t, DATA v) {
+                            vals[t - lo] = v;
+                            covered.set(t - lo);
+                        });
+                    for(TIME t = lo; t <= hi; t++)
+                        if(covered[t - lo])
+                            points.push_back({*w->f, w->digest, t, vals[t - lo]});
+                    w = e;
+                }
+                out(lo, hi, span<const point>(points));
+            });
+        }
+
+        // merge a flushed heavy part of the same dimensions; windows are gathered by label within
+        // each column and stay in the row the label was first found in, live labels are kept
+        void merge(const heavy& other) {
+            struct windows {
+                HASH row;
+                deque<counter<BY_THRESHOLD>> mine, theirs;
+            };
+            for(int col = 0; col < heavy::WIDTH; col++) {
+                vector<five_tuple> order;
+                map<five_tuple, windows> by_label;
+                auto find = [&](const five_tuple& f, HASH row) -> windows& {
+                    auto [it, added] = by_label.try_emplace(f, windows{row});
+                    if(added)
+                        order.push_back(f);
+                    return it->second;
+                };
 
+                for(int row = 0; row < heavy::HEIGHT; row++) {
+                    auto& hl = history_label[row][col];
+                    auto& hc = heavy::history[row][col];
+                    for(size_t k = 0; k < hl.size(); k++)
+                        find(hl[k], row).mine.push_back(hc[k].unseal());
+                    hl.clear();
+                    hc.clear();
+                }
+                for(int row = 0; row < heavy::HEIGHT; row++) {
+                    assert(other.counters[row][col].empty());
+                    auto& hl = other.history_label[row][col];
+                    auto& hc = other.history[row][col];
+                    for(size_t k = 0; k < hl.size(); k++)
+                        find(hl[k], row).theirs.push_back(hc[k].unseal());
+                    if(label[row][col] == other.label[row][col])
+                        frequency[row][col] += other.frequency[row][col];
+                }
+
+                for(auto& f : order) {
+                    auto& w = by_label[f];
+                    merge_history(w.mine, w.theirs);
+                    for(auto& c : w.mine) {
+                        heavy::history[w.row][col].push_back(move(c));
+                        push_label(w.row, col, f);
+                    }
+                }
+            }
+            heavy::thaw_history();
+        }
+
+        // the label of every window is stored with it
+        size_t serialize() const {
+            size_t result = 0;
+            for(int row = 0; row < heavy::HEIGHT; row++)
+                for(int col = 0; col < heavy::WIDTH; col++) {
+                    result += sizeof(heavy::history[row][col].size());
+                    for(auto& c : heavy::history[row][col])
+                        result += five_tuple::BYTES + c.serialize();
+                }
             return result;
         }
+        void serialize(bit_writer& out) const {
+            for(int row = 0; row < heavy::HEIGHT; row++)
+                for(int col = 0; col < heavy::WIDTH; col++) {
+                    auto& hc = heavy::history[row][col];
+                    out.put(hc.size());
+                    for(size_t k = 0; k < hc.size(); k++) {
+                        history_label[row][col][k].serialize(out);
+                        hc[k].serialize(out);
+                    }
+                }
+        }
+        void deserialize(bit_reader& in) {
+            heavy::reset();
+            for(int row = 0; row < heavy::HEIGHT; row++)
+                for(int col = 0; col < heavy::WIDTH; col++) {
+                    auto n = in.get<size_t>();
+                    for(size_t k = 0; k < n; k++) {
+                        five_tuple f;
+                        f.deserialize(in);
+                        heavy::history[row][col].emplace_back().deserialize(in);
+                        push_label(row, col, f);
+                    }
+                }
+            heavy::thaw_history();
+        }
 
         LABELS labels() const {
             LABELS result;
@@ -39,9 +39,9 @@ namespace Wavelet {
 
         array<pair<TIME_DIFF, TIME_DIFF>, LENGTH> history{};
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
     public:
-        void reset() override {
+        void reset() {
             start_time = 0;
             last_time = 0;
             period = 0;
@@ -56,7 +56,7 @@ namespace Wavelet {
             return t == last_time;
         }
 
-        bool count(TIME t, HASH, DATA) override {
+        bool count(TIME t, HASH, DATA) {
             assert(t > last_time);
             if(start_time == 0) [[unlikely]] {
                 start_time = t;
@@ -79,34 +79,39 @@ namespace Wavelet {
             return false;
         }
 
-        STREAM_QUEUE rebuild(HASH) const override {
+        SERIES rebuild(HASH) const {
             if(start_time == 0) [[unlikely]] {
                 return {};
             } else if(!cache.empty())
                 return cache;
 
             // rebuild in reverse order
+            size_t size = period + 1;
+            for(int pos = 0; pos < pointer; pos++)
+                size += history[pos].first + 1;
+            cache.resize(size);
+            auto it = cache.rbegin();
             TIME t = last_time;
             for(int i = 0; i <= period; i++)
-                cache.emplace_front(t--, 0);
+                *it++ = {t--, 0};
             for(int pos = pointer - 1; pos >= 0; pos--) {
                 t -= history[pos].second + 1;
                 for(int i = 0; i <= history[pos].first; i++)
-                    cache.emplace_front(t--, 0);
+                    *it++ = {t--, 0};
             }
 
             return cache;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return start_time == 0;
         }
 
-        TIME start() const override {
+        TIME start() const {
             return start_time;
         }
 
-        size_t serialize() const override {
+        size_t serialize() const {
             size_t result = 0;
             // test if start_time == 0
             result += sizeof(bool);
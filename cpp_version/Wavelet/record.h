@@ -38,6 +38,18 @@ namespace Wavelet {
             // *(uint32_t)(this);
             return result;
         }
+        void serialize(bit_writer& out) const {
+            out.write(pos, 14);
+            out.write(sqrt, 1);
+            out.write(sign, 1);
+            out.put(normalized);
+        }
+        void deserialize(bit_reader& in) {
+            pos = in.read(14);
+            sqrt = in.read(1);
+            sign = in.read(1);
+            normalized = in.get<uint16_t>();
+        }
 
         friend constexpr strong_ordering operator<=>(const record& lhs, const record& rhs);
     };
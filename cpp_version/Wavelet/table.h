@@ -8,28 +8,79 @@ using namespace std;
 
 namespace Wavelet {
 
-    template<bool BY_THRESHOLD = false>
-    class table : public basic_table<counter<BY_THRESHOLD>, FULL_WIDTH, LESS_HEIGHT> {
+    template<bool BY_THRESHOLD = false, uint32_t W = FULL_WIDTH>
+    class table : public basic_table<table<BY_THRESHOLD, W>, counter<BY_THRESHOLD>, W, LESS_HEIGHT> {
     public:
-        // for every flow from heavy-hitter table, subtract its value from the corresponding counter
+        // for every flow from heavy-hitter table, subtract its value from the corresponding counter;
+        // flows are gathered by cell, and cells are handled in parallel
         void subtract(const STREAM& dict) const {
-            for(auto& p : dict) {
+            vector<vector<pair<uint32_t, HASH>>> cells(table::HEIGHT * table::WIDTH);
+            for(uint32_t id = 0; id < dict.size(); id++) {
+                uint64_t digest = dict.label(id).digest();
                 for(int row = 0; row < table::HEIGHT; row++) {
-                    auto& f = p.first;
-                    auto q_begin = p.second.begin();
-                    auto q_end = p.second.end();
+                    auto [rem, quo] = table::locate(digest, row);
+                    cells[row * table::WIDTH + rem].emplace_back(id, quo);
+                }
+            }
+
+            rebuild_pool().for_each(cells.size(), [&](size_t k) {
+                auto& hc = table::history[k / table::WIDTH][k % table::WIDTH];
+                for(auto [id, quo] : cells[k]) {
+                    SERIES q = dict.at(id);
+                    auto q_begin = q.begin();
+                    auto q_end = q.end();
                     assert(q_begin != q_end);
-                    HASH h = f.hash(table::seeds[row]);
-                    HASH rem = h % table::WIDTH;
-                    HASH quo = h / table::WIDTH;
-                    auto& hc = table::history[row][rem];
                     for(auto c = table::first_history(hc, q_begin->first); c != hc.end(); c++) {
                         if(q_begin == q_end) [[unlikely]]
                             break;
                         q_begin = c->subtract(quo, q_begin, q_end);
                     }
                 }
+            });
+        }
+
+        // whether two digests meet in a cell of some row
+        static bool shares_cell(uint64_t x, uint64_t y) {
+            for(int row = 0; row < table::HEIGHT; row++)
+                if(table::locate(x, row).first == table::locate(y, row).first)
+                    return true;
+            return false;
+        }
+        // values of digest at the slots of [a, b], b - a < QUERY_BLOCK, to out(t, value) in time order, as rebuild
+        // gives them once subtract has taken the heavy points out of every window they fall in. Windows are decoded
+        // from their coefficients, so what an earlier subtract left in their caches is not seen
+        template<typename P, typename F>
+        void query_block(uint64_t digest, TIME a, TIME b, span<const P> heavy, F&& out) const {
+            array<array<DATA, table::HEIGHT>, QUERY_BLOCK> vals{};
+            array<bitset<QUERY_BLOCK>, table::HEIGHT> covered{};
+            table::query_rows(digest, a, b, vals.data(), covered.data());
+            for(int row = 0; row < table::HEIGHT; row++) {
+                HASH col = table::locate(digest, row).first;
+                for(auto& p : heavy)
+                    if(covered[row][p.t - a] && table::locate(p.digest, row).first == col)
+                        vals[p.t - a][row] -= p.value;
             }
+            for(TIME t = a; t <= b; t++)
+                out(t, this->select_val(vals[t - a]));
+        }
+
+        // merge a flushed table of the same dimensions cell by cell
+        void merge(const table& other) {
+            for(int row = 0; row < table::HEIGHT; row++)
+                for(int col = 0; col < table::WIDTH; col++) {
+                    assert(other.counters[row][col].empty());
+                    auto& hc = table::history[row][col];
+                    deque<counter<BY_THRESHOLD>> mine, theirs;
+                    for(auto& s : hc)
+                        mine.push_back(s.unseal());
+                    for(auto& s : other.history[row][col])
+                        theirs.push_back(s.unseal());
+                    hc.clear();
+                    merge_history(mine, theirs);
+                    for(auto& c : mine)
+                        hc.push_back(c);
+                }
+            table::thaw_history();
         }
 
         void list_min(vector<record>& result) const {
@@ -7,11 +7,11 @@
 
 using namespace std;
 
-template<bool BY_THRESHOLD = false>
+template<bool BY_THRESHOLD = false, uint32_t W = FULL_WIDTH>
 class wavelet : public abstract_scheme {
 protected:
-    Wavelet::heavy<BY_THRESHOLD> top{};
-    Wavelet::table<BY_THRESHOLD> low{};
+    Wavelet::heavy<BY_THRESHOLD, W / 2> top{};
+    Wavelet::table<BY_THRESHOLD, W> low{};
 public:
     void reset() override {
         top.reset();
@@ -19,8 +19,26 @@ public:
     }
 
     void count(const five_tuple& f, const TIME t, const DATA c) override {
-        top.count(f, t, c);
-        low.count(f, t, c);
+        uint64_t digest = f.digest();
+        top.count(f, digest, t, c);
+        low.count(digest, t, c);
+    }
+
+    void count_batch(span<const PACKET> batch) override {
+        thread_local vector<uint64_t> digest;
+        digest.resize(ROUND_UP(batch.size(), DIGEST_BATCH));
+        for(size_t pos = 0; pos < batch.size(); pos += DIGEST_BATCH)
+            digest_batch(batch.subspan(pos, min<size_t>(DIGEST_BATCH, batch.size() - pos)), &digest[pos]);
+
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(i + PREFETCH_AHEAD < batch.size()) [[likely]] {
+                top.prefetch(digest[i + PREFETCH_AHEAD]);
+                low.prefetch(digest[i + PREFETCH_AHEAD]);
+            }
+            auto& [f, t, c] = batch[i];
+            top.count(f, digest[i], t, c);
+            low.count(digest[i], t, c);
+        }
     }
 
     void flush() override {
@@ -29,25 +47,17 @@ public:
     }
 
     STREAM rebuild(const STREAM& dict) const override {
-        STREAM heavy_dict;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            auto temp = top.rebuild(f, q.front().first, q.back().first);
-            if(!temp.empty())
-                heavy_dict[f] = move(temp);
-        }
+        STREAM heavy_dict = top.rebuild_all(dict);
         low.subtract(heavy_dict);
 
-        STREAM result;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            STREAM_QUEUE q_top = heavy_dict[f];
-            STREAM_QUEUE q_low = low.rebuild(f, q.front().first, q.back().first);
-            STREAM_QUEUE& q_res = result[f];
+        STREAM result = low.rebuild_all(dict);
+        vector<pair<TIME, DATA>> q_res;
+        for(auto [f, q_top] : heavy_dict) {
+            SERIES q_low = result.get(f);
+            q_res.clear();
             set_union(q_top.begin(), q_top.end(), q_low.begin(), q_low.end(), back_inserter(q_res),
                       [](const pair<TIME, DATA>& l, const pair<TIME, DATA>& r) { return l.first < r.first; });
+            result.assign(f, q_res);
         }
 
         if(!BY_THRESHOLD)
@@ -55,12 +65,60 @@ public:
         return result;
     }
 
+    /* values of f at the slots of [a, b] to out(t, value) in time order, as rebuild gives them when dict holds every
+     * flow: the recorded points of f where it has them, else the light part less the recorded points of the labels
+     * sharing a cell with f. Only windows over [a, b] are decoded, and the thresholds are left as they are */
+    template<typename F>
+    void query(const five_tuple& f, TIME a, TIME b, F&& out) const {
+        typedef typename decltype(top)::point point;
+        uint64_t digest = f.digest();
+        top.query(a, b, [&](uint64_t d) { return low.shares_cell(digest, d); },
+                  [&](TIME lo, TIME hi, span<const point> heavy) {
+            array<DATA, QUERY_BLOCK> vals;
+            low.query_block(digest, lo, hi, heavy, [&](TIME t, DATA v) { vals[t - lo] = v; });
+            for(auto& p : heavy)
+                if(p.f == f)
+                    vals[p.t - lo] = p.value;
+            for(TIME t = lo; t <= hi; t++)
+                out(t, vals[t - lo]);
+        });
+    }
+    DATA query_point(const five_tuple& f, TIME t) const override {
+        DATA result = 0;
+        query(f, t, t, [&](TIME, DATA v) { result = v; });
+        return result;
+    }
+    int64_t query_sum(const five_tuple& f, TIME a, TIME b) const override {
+        int64_t result = 0;
+        query(f, a, b, [&](TIME, DATA v) { result += v; });
+        return result;
+    }
+    DATA query_max(const five_tuple& f, TIME a, TIME b) const override {
+        DATA result = 0;
+        query(f, a, b, [&](TIME, DATA v) { result = max(result, v); });
+        return result;
+    }
+
+    // aggregate a flushed sketch of the same dimensions, e.g. from another vantage point
+    void merge(const wavelet& other) {
+        top.merge(other.top);
+        low.merge(other.low);
+    }
+
     size_t serialize() const override {
         size_t result = 0;
         result += top.serialize();
         result += low.serialize();
         return result;
     }
+    void serialize(bit_writer& out) const override {
+        top.serialize(out);
+        low.serialize(out);
+    }
+    void deserialize(bit_reader& in) override {
+        top.deserialize(in);
+        low.deserialize(in);
+    }
 
     void set_min() const {
         vector<Wavelet::record> result = {};
@@ -9,7 +9,7 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    typedef STREAM_QUEUE::const_iterator SQptr;
+    typedef SERIES::iterator SQptr;
 
     template<unsigned QUEUE_N = 1>
     class counter : public abstract_counter {
@@ -26,7 +26,7 @@ namespace WaveletAlt {
 
         interval time{};
 
-        mutable STREAM_QUEUE cache{};
+        mutable vector<pair<TIME, DATA>> cache{};
 
         void heap_insert(uint8_t level, DATA d) {
             uint16_t pos = (read_count >> level) << level;
@@ -51,7 +51,7 @@ namespace WaveletAlt {
         uint16_t get_count() const {
             return read_count;
         }
-        void reset() override {
+        void reset() {
             read_count = 0;
             value = 0;
             for(auto& d : detail)
@@ -60,7 +60,7 @@ namespace WaveletAlt {
             cache.clear();
         }
 
-        bool count(TIME t, HASH h, DATA c) override {
+        bool count(TIME t, HASH h, DATA c) {
             DATA sign = h % 2 ? c : -c;
             if(time.same_as_last(t)) {
                 value += sign;
@@ -77,7 +77,7 @@ namespace WaveletAlt {
             return false;
         }
 
-        void flush() override {
+        void flush() {
             if(empty())
                 return;
 
@@ -95,11 +95,12 @@ namespace WaveletAlt {
             value = 0;
         }
 
-        STREAM_QUEUE rebuild(HASH h) const override {
+        SERIES rebuild(HASH h) const {
             assert(!empty());
             DATA sign = h % 2 ? 1 : -1;
             if(cache.empty()) {
-                cache = time.rebuild({});
+                auto times = time.rebuild({});
+                cache.assign(times.begin(), times.end());
 
                 vector<DATA> temp(read_count, 0);
                 // copy heap data
@@ -140,7 +141,9 @@ namespace WaveletAlt {
                     cache[pos].second = temp[pos] > 0 ? temp[pos] : 1;
             }
 
-            STREAM_QUEUE result = cache;
+            // the signed copy is shared by all counters rebuilt on this thread
+            thread_local vector<pair<TIME, DATA>> result;
+            result = cache;
             for(auto& p : result)
                 p.second = sign * p.second > 0 ? sign * p.second : 1;
             return result;
@@ -172,11 +175,11 @@ namespace WaveletAlt {
             return it;
         }
 
-        bool empty() const override {
+        bool empty() const {
             return time.empty();
         }
 
-        TIME start() const override {
+        TIME start() const {
             return time.start();
         }
     };
@@ -8,8 +8,8 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    template<unsigned QUEUE_N = 1>
-    class heavy : public Wavelet::heavy<QUEUE_N> {
+    template<unsigned QUEUE_N = 1, uint32_t W = HALF_WIDTH>
+    class heavy : public Wavelet::heavy<QUEUE_N, W> {
 
     };
 
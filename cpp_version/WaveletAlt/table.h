@@ -8,24 +8,23 @@ using namespace std;
 
 namespace WaveletAlt {
 
-    template<unsigned QUEUE_N = 1>
-    class table : public basic_table<counter<QUEUE_N>, HALF_WIDTH, FULL_HEIGHT> {
+    template<unsigned QUEUE_N = 1, uint32_t W = HALF_WIDTH>
+    class table : public basic_table<table<QUEUE_N, W>, counter<QUEUE_N>, W, FULL_HEIGHT> {
+        friend class basic_table<table, counter<QUEUE_N>, W, FULL_HEIGHT>;
     protected:
-        DATA select_val(vector<DATA>& vals) const override {
+        DATA select_val(vector<DATA>& vals) const {
             return table::select_median(vals);
         }
     public:
         // for every flow from heavy-hitter table, subtract its value from the corresponding counter
         void subtract(const STREAM& dict) const {
-            for(auto& p : dict) {
+            for(auto [f, q] : dict) {
+                uint64_t digest = f.digest();
                 for(int row = 0; row < table::HEIGHT; row++) {
-                    auto& f = p.first;
-                    auto q_begin = p.second.begin();
-                    auto q_end = p.second.end();
+                    auto q_begin = q.begin();
+                    auto q_end = q.end();
                     assert(q_begin != q_end);
-                    HASH h = f.hash(table::seeds[row]);
-                    HASH rem = h % table::WIDTH;
-                    HASH quo = h / table::WIDTH;
+                    auto [rem, quo] = table::locate(digest, row);
                     auto& hc = table::history[row][rem];
                     for(auto c = table::first_history(hc, q_begin->first); c != hc.end(); c++) {
                         q_begin = c->subtract(quo, q_begin, q_end);
@@ -7,11 +7,11 @@
 
 using namespace std;
 
-template<unsigned QUEUE_N = 1>
+template<unsigned QUEUE_N = 1, uint32_t W = FULL_WIDTH>
 class wavelet_alt : public abstract_scheme {
 protected:
-    WaveletAlt::heavy<QUEUE_N> top{};
-    WaveletAlt::table<QUEUE_N> low{};
+    WaveletAlt::heavy<QUEUE_N, W / 2> top{};
+    WaveletAlt::table<QUEUE_N, W / 2> low{};
 public:
     void reset() override {
         top.reset();
@@ -30,24 +30,27 @@ public:
 
     STREAM rebuild(const STREAM& dict) const override {
         STREAM heavy_dict;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            auto temp = top.rebuild(f, q.front().first, q.back().first);
-            if(!temp.empty())
-                heavy_dict[f] = move(temp);
+        vector<pair<TIME, DATA>> q_top;
+        for(auto [f, q] : dict) {
+            q_top.clear();
+            top.rebuild(f, q_top);
+            if(!q_top.empty())
+                heavy_dict.assign(f, q_top);
         }
         low.subtract(heavy_dict);
 
         STREAM result;
-        for(auto& p : dict) {
-            auto& f = p.first;
-            auto& q = p.second;
-            STREAM_QUEUE q_top = heavy_dict[f];
-            STREAM_QUEUE q_low = low.rebuild(f, q.front().first, q.back().first);
-            STREAM_QUEUE& q_res = result[f];
+        result.reserve(dict.size(), dict.slots());
+        vector<pair<TIME, DATA>> q_low, q_res;
+        for(auto [f, q] : dict) {
+            TIME start = q.front().first, last = q.back().first;
+            SERIES q_top = heavy_dict.get(f);
+            q_low.resize(last - start + 1);
+            low.rebuild(f, start, last, q_low);
+            q_res.clear();
             set_union(q_top.begin(), q_top.end(), q_low.begin(), q_low.end(), back_inserter(q_res),
                       [](const pair<TIME, DATA>& l, const pair<TIME, DATA>& r) { return l.first < r.first; });
+            result.assign(f, q_res);
         }
 
         return result;
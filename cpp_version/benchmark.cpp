@@ -4,6 +4,21 @@
 
 #include "benchmark.h"
 
+#ifdef COUNT_ALLOCS
+void* operator new(size_t n) {
+    thread_allocs++;
+    if(void* p = malloc(n > 0 ? n : 1))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+#endif
+
 /* benchmarks, compare right to left */
 // calculate gradient
 template<typename C, typename T=C::value_type>
@@ -129,7 +144,7 @@ ostream& operator<<(ostream& os, const methods& t) {
     return os;
 }
 
-benchmark::benchmark(const methods t, const five_tuple &f, const STREAM_QUEUE &lhs, const STREAM_QUEUE &rhs) : type(t), key(f) {
+benchmark::benchmark(const methods t, const uint32_t m, const five_tuple &f, SERIES lhs, SERIES rhs) : type(t), memory(m), key(f) {
     recorded = rhs.size();
     original = lhs.size();
 
@@ -157,7 +172,7 @@ benchmark::benchmark(const methods t, const five_tuple &f, const STREAM_QUEUE &l
 }
 
 ostream &operator<<(ostream &os, const benchmark &t) {
-    os << t.type << "," << benchmark::sketch_size << "," << t.key.dst_ip << "," << t.original
+    os << t.type << "," << t.memory << "," << t.key.dst_ip << "," << t.original
        << "," << t.l1_norm
        << "," << t.l2_norm
        << "," << t.avg_err
@@ -171,22 +186,20 @@ ostream &operator<<(ostream &os, const benchmark &t) {
     return os;
 }
 
-void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type) {
-    const static STREAM_QUEUE default_queue;
-    for(auto &o: lhs) {
+void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type, const uint32_t memory) {
+    for(auto [f, l_queue] : lhs) {
 #ifdef SELECT_OUT
-        if(o.first.hash() % HALF_WIDTH != breakpoint.hash() % HALF_WIDTH)
+        if(f.hash() % HALF_WIDTH != breakpoint.hash() % HALF_WIDTH)
             continue;
 #endif
 #ifdef FILTER_LOW
-        if(o.second.size() < FILTER_LOW)
+        if(l_queue.size() < FILTER_LOW)
             continue;
 #endif
 
-        auto &l_queue = o.second;
-        auto &r_queue = rhs.contains(o.first) ? rhs.find(o.first)->second : default_queue;
+        auto r_queue = rhs.get(f);
 
-        benchmark p(type, o.first, l_queue, r_queue);
+        benchmark p(type, memory, f, l_queue, r_queue);
         os << p << endl;
     }
 }
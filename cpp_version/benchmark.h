@@ -22,6 +22,7 @@ ostream& operator<<(ostream& os, const methods& t);
 
 class benchmark {
     methods type;
+    uint32_t memory;
     five_tuple key;
     uint32_t recorded;
     uint32_t original;
@@ -37,13 +38,12 @@ class benchmark {
     double gd_cos_dis;
 
 public:
-    constexpr static const uint32_t sketch_size = MEMORY;
     constexpr static const char format[] = "class,memory,id,length,l1,l2,are,energy,cos,g-l1,g-l2,g-energy,g-cos";
-    benchmark(methods t, const five_tuple& f, const STREAM_QUEUE& lhs, const STREAM_QUEUE& rhs);
+    benchmark(methods t, uint32_t m, const five_tuple& f, SERIES lhs, SERIES rhs);
     friend ostream& operator<<(ostream& os, const benchmark& t);
 };
 
-void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type);
+void compare(const STREAM& lhs, const STREAM& rhs, ostream& os, const methods type, const uint32_t memory = MEMORY);
 
 
 #endif //BENCHMARK_H
@@ -0,0 +1,86 @@
+//
+// Measure the encode / decode throughput of flushed sketches, and check that a decoded sketch rebuilds the same
+//
+
+#include <iostream>
+#include "io_helper.h"
+#include "config.h"
+#include "schemes.h"
+
+using namespace std;
+
+constexpr static const int ROUNDS = 5;
+
+bool same_rebuild(const STREAM& lhs, const STREAM& rhs) {
+    if(lhs.size() != rhs.size())
+        return false;
+    for(auto [f, q] : lhs) {
+        SERIES r = rhs.get(f);
+        if(!equal(q.begin(), q.end(), r.begin(), r.end()))
+            return false;
+    }
+    return true;
+}
+
+template<uint32_t W>
+void measure(const config& cfg, const SORTED& input, const STREAM& dict) {
+    constexpr uint32_t memory = MEMORY_OF(W);
+    if(!cfg.use(memory))
+        return;
+    for(methods m : {methods::WAVE_IDEAL, methods::WAVE_PRACTICAL, methods::OMNIWINDOW, methods::NAIVE_CMS,
+                     methods::FOURIER, methods::PERSIST_CMS, methods::PERSIST_AMS}) {
+        if(!cfg.use(m))
+            continue;
+        auto model = make_scheme<W>(m, cfg.sharded);
+        for(size_t pos = 0; pos < input.size(); pos += BATCH_SIZE)
+            model->count_batch(span<const PACKET>(input).subspan(pos, min<size_t>(BATCH_SIZE, input.size() - pos)));
+        model->flush();
+
+        bit_writer out;
+        auto start_time = chrono::high_resolution_clock::now();
+        for(int round = 0; round < ROUNDS; round++) {
+            out.clear();
+            model->serialize(out);
+        }
+        auto encode_time = chrono::high_resolution_clock::now();
+        auto bytes = out.data();
+
+        auto copy = make_scheme<W>(m, cfg.sharded);
+        size_t read = 0;
+        for(int round = 0; round < ROUNDS; round++) {
+            bit_reader in(bytes);
+            copy->deserialize(in);
+            read = in.bits();
+        }
+        auto decode_time = chrono::high_resolution_clock::now();
+
+        size_t size = model->serialize();
+        if(out.bits() != size * 8 || read != out.bits()) [[unlikely]]
+            cerr << m << " " << memory << ": " << out.bits() << " bits written, " << read
+                 << " bits read, " << size * 8 << " bits expected" << endl;
+        if(!same_rebuild(model->rebuild(dict), copy->rebuild(dict))) [[unlikely]]
+            cerr << m << " " << memory << ": decoded sketch rebuilds differently" << endl;
+
+        chrono::duration<double> encode_diff = encode_time - start_time, decode_diff = decode_time - encode_time;
+        double mb = double(size) * ROUNDS / (1 << 20);
+        cout << m << "," << memory << "," << size << ","
+             << mb / encode_diff.count() << "," << mb / decode_diff.count() << endl;
+    }
+}
+
+template<uint32_t... Ws>
+void measure_all(const config& cfg, const SORTED& input, const STREAM& dict) {
+    (measure<Ws>(cfg, input, dict), ...);
+}
+
+int main(int argc, char* argv[]) {
+    auto cfg = config::parse(argc, argv);
+    rebuild_threads = cfg.rebuild_threads;
+    SORTED input = parse_trace(cfg.input, {cfg.timescale, cfg.parse_threads});
+    STREAM dict = sum_by_flow(input);
+
+    cout << "class,memory,size,encode-MB/s,decode-MB/s" << endl;
+    measure_all<SWEEP_WIDTHS>(cfg, input, dict);
+
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include "config.h"
+
+static const methods selectable[] = {
+    methods::WAVE_IDEAL,
+    methods::WAVE_PRACTICAL,
+    methods::OMNIWINDOW,
+    methods::NAIVE_CMS,
+    methods::FOURIER,
+    methods::PERSIST_CMS,
+    methods::PERSIST_AMS
+};
+static const uint32_t widths[] = {SWEEP_WIDTHS};
+
+static string trim(const string& s) {
+    auto l = s.find_first_not_of(" \t\r");
+    if(l == string::npos)
+        return "";
+    auto r = s.find_last_not_of(" \t\r");
+    return s.substr(l, r - l + 1);
+}
+
+static vector<string> split(const string& s) {
+    vector<string> result;
+    stringstream ss(s);
+    string item;
+    while(getline(ss, item, ','))
+        if(!trim(item).empty())
+            result.push_back(trim(item));
+    return result;
+}
+
+static bool to_uint(const string& s, uint32_t& out) {
+    if(s.empty() || s.find_first_not_of("0123456789") != string::npos)
+        return false;
+    out = stoul(s);
+    return true;
+}
+
+static bool to_bool(const string& s, bool& out) {
+    if(s == "1" || s == "true" || s == "on")
+        out = true;
+    else if(s == "0" || s == "false" || s == "off")
+        out = false;
+    else
+        return false;
+    return true;
+}
+
+static bool to_method(const string& s, methods& out) {
+    for(auto m : selectable) {
+        stringstream ss;
+        ss << m;
+        if(ss.str() == s) {
+            out = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+config::config() {
+#ifdef FILE_OUT
+    report = FILE_OUT;
+#endif
+#ifdef FLOW_OUT
+    flow = FLOW_OUT;
+#endif
+#ifdef META_OUT
+    meta = META_OUT;
+#endif
+#ifdef STREAM_IN
+    stream = true;
+#endif
+#ifdef STREAM_TRUTH
+    truth = true;
+#endif
+#ifdef SHARDED_IN
+    sharded = true;
+#endif
+#ifdef EPOCH_IN
+    epoch = EPOCH_IN;
+#endif
+#ifdef USE_NAIVE_CMS
+    schemes.push_back(USE_NAIVE_CMS);
+#endif
+#ifdef USE_OMNIWINDOW
+    schemes.push_back(USE_OMNIWINDOW);
+#endif
+#ifdef USE_FOURIER
+    schemes.push_back(USE_FOURIER);
+#endif
+#ifdef USE_PERSIST_CMS
+    schemes.push_back(USE_PERSIST_CMS);
+#endif
+#ifdef USE_PERSIST_AMS
+    schemes.push_back(USE_PERSIST_AMS);
+#endif
+#ifdef USE_WAVE_IDEAL
+    schemes.push_back(USE_WAVE_IDEAL);
+#endif
+#ifdef USE_WAVE_PRACTICAL
+    schemes.push_back(USE_WAVE_PRACTICAL);
+#endif
+}
+
+bool config::set(const string& key, const string& value) {
+    if(key == "input")
+        input = value;
+    else if(key == "report")
+        report = value;
+    else if(key == "flow")
+        flow = value;
+    else if(key == "meta")
+        meta = value;
+    else if(key == "timescale")
+        return to_uint(value, timescale) && timescale > 0;
+    else if(key == "parse-threads")
+        return to_uint(value, parse_threads);
+    else if(key == "eval-threads")
+        return to_uint(value, eval_threads);
+    else if(key == "rebuild-threads")
+        return to_uint(value, rebuild_threads);
+    else if(key == "stream")
+        return to_bool(value, stream);
+    else if(key == "truth")
+        return to_bool(value, truth);
+    else if(key == "sharded")
+        return to_bool(value, sharded);
+    else if(key == "epoch")
+        return to_uint(value, epoch);
+    else if(key == "epoch-buffers")
+        return to_uint(value, epoch_buffers) && epoch_buffers > 0;
+    else if(key == "schemes") {
+        schemes.clear();
+        for(auto& s : split(value)) {
+            methods m;
+            if(!to_method(s, m))
+                return false;
+            schemes.push_back(m);
+        }
+    }
+    else if(key == "memory") {
+        memories.clear();
+        if(value == "all") {
+            for(auto w : widths)
+                memories.push_back(MEMORY_OF(w));
+            return true;
+        }
+        for(auto& s : split(value)) {
+            uint32_t m;
+            if(!to_uint(s, m) || find_if(begin(widths), end(widths),
+                                         [m](uint32_t w) { return MEMORY_OF(w) == m; }) == end(widths))
+                return false;
+            memories.push_back(m);
+        }
+    }
+    else
+        return false;
+    return true;
+}
+
+bool config::load(const string& fname) {
+    ifstream f(fname);
+    if(!f)
+        return false;
+    string line;
+    while(getline(f, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if(line.empty())
+            continue;
+        auto eq = line.find('=');
+        if(eq == string::npos || !set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)))) {
+            cerr << fname << ": invalid line " << line << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void usage(const char* name) {
+    cerr << "usage: " << name << " [--config file] [--key value | --key=value]..." << endl
+         << "  input          trace file, csv or binary" << endl
+         << "  report         per-flow report, empty for console" << endl
+         << "  flow           sample of the breakpoint flow, empty to skip" << endl
+         << "  meta           transform and rebuild times, empty for console" << endl
+         << "  schemes        comma separated, from";
+    for(auto m : selectable)
+        cerr << " " << m;
+    cerr << endl << "  memory         comma separated bytes or all, from";
+    for(auto w : widths)
+        cerr << " " << MEMORY_OF(w);
+    cerr << endl
+         << "  timescale      input time(ns) per time slot" << endl
+         << "  parse-threads  0 for hardware concurrency" << endl
+         << "  eval-threads   0 for hardware concurrency" << endl
+         << "  rebuild-threads  threads rebuilding one scheme, 0 for hardware concurrency" << endl
+         << "  stream         feed packets in batches instead of loading the whole trace" << endl
+         << "  truth          accumulate the ground truth while streaming" << endl
+         << "  sharded        count wavelet schemes in " << SHARDS << " shards on threads of their own" << endl
+         << "  epoch          stream and rebuild every epoch of this many time slots on its own, 0 to disable" << endl
+         << "  epoch-buffers  sketches in rotation per scheme" << endl;
+}
+
+config config::parse(int argc, char* argv[]) {
+    config cfg;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            exit(0);
+        }
+        if(arg.rfind("--", 0) != 0) [[unlikely]] {
+            usage(argv[0]);
+            exit(-1);
+        }
+        string key = arg.substr(2), value;
+        auto eq = key.find('=');
+        if(eq != string::npos) {
+            value = key.substr(eq + 1);
+            key = key.substr(0, eq);
+        } else if(i + 1 < argc)
+            value = argv[++i];
+        else {
+            usage(argv[0]);
+            exit(-1);
+        }
+
+        bool valid = key == "config" ? cfg.load(value) : cfg.set(key, value);
+        if(!valid) [[unlikely]] {
+            cerr << "invalid option --" << key << " " << value << endl;
+            exit(-1);
+        }
+    }
+    return cfg;
+}
+
+bool config::use(methods m) const {
+    return find(schemes.begin(), schemes.end(), m) != schemes.end();
+}
+
+bool config::use(uint32_t memory) const {
+    return find(memories.begin(), memories.end(), memory) != memories.end();
+}
@@ -0,0 +1,44 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "Utility/headers.h"
+#include "benchmark.h"
+
+using namespace std;
+
+/* run configuration; defaults come from debug.h and parameter.h,
+ * overridden by a config file of "key = value" lines and then by --key value arguments */
+class config {
+public:
+    string input = FILE_IN;
+    // empty for console
+    string report;
+    // empty to skip
+    string flow;
+    // empty for console
+    string meta;
+    vector<methods> schemes;
+    vector<uint32_t> memories = {MEMORY};
+    uint32_t timescale = TIMESCALE;
+    unsigned parse_threads = PARSE_THREADS;
+    unsigned eval_threads = EVAL_THREADS;
+    unsigned rebuild_threads = REBUILD_THREADS;
+    bool stream = false;
+    bool truth = false;
+    bool sharded = false;
+    // time slots per epoch, 0 to count the trace as a whole
+    uint32_t epoch = 0;
+    uint32_t epoch_buffers = EPOCH_BUFFERS;
+
+    config();
+
+    // false if the key or the value is unknown
+    bool set(const string& key, const string& value);
+    bool load(const string& fname);
+    static config parse(int argc, char* argv[]);
+
+    bool use(methods m) const;
+    bool use(uint32_t memory) const;
+};
+
+#endif //CONFIG_H
@@ -0,0 +1,23 @@
+//
+// Convert a csv trace to the binary trace format read by parse_trace
+//
+
+#include <iostream>
+#include "io_helper.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if(argc < 3 || (argc == 4 && string(argv[3]) != "--delta") || argc > 4) {
+        cerr << "usage: " << argv[0] << " <trace.csv> <trace.bin> [--delta]" << endl;
+        return -1;
+    }
+
+    auto start_time = chrono::high_resolution_clock::now();
+    size_t count = convert_csv_binary(argv[1], argv[2], argc == 4);
+    auto end_time = chrono::high_resolution_clock::now();
+    chrono::duration<double> time_diff = end_time - start_time;
+    cerr << "converted " << count << " records in " << time_diff.count() << "s" << endl;
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 
 #include "io_helper.h"
 #include "benchmark.h"
+#include "Utility/epoch.h"
 
 STREAM parse_csv_full(const string& fname) {
     constexpr static const int scale = 65536;
@@ -11,7 +12,7 @@ STREAM parse_csv_full(const string& fname) {
     if(!f.is_open()) [[unlikely]]
                 exit(-1);
 
-    STREAM result;
+    flow_builder result;
     string line;
     static regex line_fmt(R"(^\((TCP|UDP)\)([0-9.]+):(\d+)<>([0-9.]+):(\d+),\d*?(\d{1,9}),(\d+),\d+\s*$)");
 
@@ -31,7 +32,7 @@ STREAM parse_csv_full(const string& fname) {
 #ifdef SELECT_IN
             if(t.hash() % HALF_WIDTH == breakpoint.hash() % HALF_WIDTH)
 #endif
-            result[t].emplace_back(stoul(match[6].str()), stoi(match[7].str()));
+            result.push(t, stoul(match[6].str()), stoi(match[7].str()));
         }
         i++;
         if(i % scale == 0)
@@ -39,75 +40,573 @@ STREAM parse_csv_full(const string& fname) {
     }
     cout << endl;
 
-    return result;
+    return result.build();
 }
-SORTED parse_csv_simple(const string& fname) {
-    constexpr static const int scale = 65536 * 4;
-    ifstream f(fname);
-    if(!f.is_open()) [[unlikely]]
-                exit(-1);
+// parse an unsigned decimal at p, advance p past it; return false if no digit is found
+static inline bool parse_uint(const char*& p, const char* end, uint32_t& out) {
+    uint32_t result = 0;
+    const char* q = p;
+    // swar: resolve up to 8 digits with one load when they are in bounds
+    if(end - q >= 8) [[likely]] {
+        uint64_t chunk;
+        memcpy(&chunk, q, sizeof(chunk));
+        uint64_t digit = (chunk & 0xF0F0F0F0F0F0F0F0u) | (((chunk + 0x0606060606060606u) & 0xF0F0F0F0F0F0F0F0u) >> 4);
+        digit ^= 0x3333333333333333u;
+        int n = digit == 0 ? 8 : countr_zero(digit) / 8;
+        if(n == 0) [[unlikely]]
+            return false;
 
-    SORTED result;
+        chunk = (chunk - 0x3030303030303030u) << (64 - 8 * n);
+        chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFu;
+        chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFu;
+        chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFu;
+        result = chunk;
+        q += n;
+        if(n < 8) [[likely]] {
+            p = q;
+            out = result;
+            return true;
+        }
+    }
+    while(q != end && (unsigned)(*q - '0') < 10u) {
+        result = result * 10 + (*q - '0');
+        q++;
+    }
+    if(q == p) [[unlikely]]
+        return false;
+    p = q;
+    out = result;
+    return true;
+}
 
-    uint32_t i = 0;
-    uint32_t id, len, qlen;
-    uint32_t time;
-    char comma;
+// step p over the separator c; return false if it is not there
+static inline bool skip_separator(const char*& p, const char* end, char c) {
+    if(p == end || *p != c) [[unlikely]]
+        return false;
+    p++;
+    return true;
+}
 
-    // ignore first line
-    f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    while(f >> id >> comma >> len >> comma >> time >> comma >> qlen) {
-        five_tuple ft(id);
+// tokenize one "fid,byte,time_ns,qlen" line at p into v; return 1 if parsed, 0 at end, -1 if malformed
+static inline int scan_line(const char*& p, const char* end, uint32_t (&v)[4]) {
+    while(p != end && isspace(static_cast<unsigned char>(*p)))
+        p++;
+    if(p == end)
+        return 0;
+    if(!parse_uint(p, end, v[0]) || !skip_separator(p, end, ',') ||
+       !parse_uint(p, end, v[1]) || !skip_separator(p, end, ',') ||
+       !parse_uint(p, end, v[2]) || !skip_separator(p, end, ',') ||
+       !parse_uint(p, end, v[3])) [[unlikely]]
+        return -1;
+    // the last field ends the line
+    if(p != end && *p != '\n' && *p != '\r') [[unlikely]]
+        return -1;
+    return 1;
+}
+
+// outcome of scanning a csv range
+enum class scan_state {
+    // every line is read
+    COMPLETE,
+    // emit asked to stop
+    STOPPED,
+    // a line is not "fid,byte,time_ns,qlen"
+    MALFORMED
+};
+
+// tokenize lines in [p, end) into emit(fid, byte, time_ns, qlen) until emit returns false or a line is malformed
+template<typename F>
+static scan_state scan_csv(const char* p, const char* end, F&& emit) {
+    uint32_t v[4];
+    while(true) {
+        int state = scan_line(p, end, v);
+        if(state == 0)
+            return scan_state::COMPLETE;
+        if(state < 0) [[unlikely]]
+            return scan_state::MALFORMED;
+        if(!emit(v[0], v[1], v[2], v[3])) [[unlikely]]
+            return scan_state::STOPPED;
+    }
+}
+
+// append a raw record as packet, return false if input should stop after it
+static inline bool push_packet(SORTED& result, uint32_t id, uint32_t len, uint32_t time, uint32_t timescale) {
+    five_tuple ft(id);
 #ifdef SELECT_IN
-        if(ft.hash() % HALF_WIDTH == breakpoint.hash() % HALF_WIDTH)
+    if(ft.hash() % HALF_WIDTH == breakpoint.hash() % HALF_WIDTH)
 #endif
 #ifdef BY_BYTES
-        result.emplace_back(ft, time / TIMESCALE + 1, len);
+    result.emplace_back(ft, time / timescale + 1, len);
 #else
-        result.emplace_back(ft, time / TIMESCALE + 1, 1);
+    result.emplace_back(ft, time / timescale + 1, 1);
 #endif
-        i++;
-        if(i % scale == 0)
-            cout << '+' << flush;
 #ifdef FILTER_TIME
-        if(time >= FILTER_TIME) [[unlikely]]
-            break;
+    if(time >= FILTER_TIME) [[unlikely]]
+        return false;
 #endif
-    }
-
-    cout << endl;
-    f.close();
+    return true;
+}
 
-    sort(result.begin(), result.end(),
-         [](const auto& lhs, const auto& rhs) { return get<1>(lhs) < get<1>(rhs); });
+static void sort_by_time(SORTED& result) {
+    auto by_time = [](const auto& lhs, const auto& rhs) { return get<1>(lhs) < get<1>(rhs); };
+    if(!is_sorted(result.begin(), result.end(), by_time))
+        stable_sort(result.begin(), result.end(), by_time);
+}
 
+static void print_interval(const SORTED& result, uint32_t timescale) {
     TIME min_time = get<1>(result.front());
     TIME max_time = get<1>(result.back());
     TIME interval = max_time - min_time + 1;
-    cout << "Time interval: " << (double)interval * TIMESCALE * 1e-6 << "ms" << endl;
+    cout << "Time interval: " << (double)interval * timescale * 1e-6 << "ms" << endl;
+}
+
+// parse records in [p, end) sorted by time
+static scan_state parse_csv_chunk(const char* p, const char* end, SORTED& result, uint32_t timescale) {
+    scan_state state = scan_csv(p, end, [&](uint32_t id, uint32_t len, uint32_t time, uint32_t) {
+        return push_packet(result, id, len, time, timescale);
+    });
+    sort_by_time(result);
+    return state;
+}
+
+SORTED parse_csv_simple(const string& fname, const trace_options& opt) {
+    mapped_file f(fname);
+    if(!f.is_open()) [[unlikely]]
+                exit(-1);
+
+    // ignore first line
+    const char* begin = find(f.begin(), f.end(), '\n');
+    const char* end = f.end();
+
+    // split at newline boundaries, one chunk per worker
+    unsigned n = opt.threads > 0 ? opt.threads : max(1u, thread::hardware_concurrency());
+    vector<const char*> bounds{begin};
+    for(unsigned k = 1; k < n; k++)
+        bounds.push_back(find(max(bounds.back(), begin + (end - begin) * k / n), end, '\n'));
+    bounds.push_back(end);
+
+    vector<SORTED> chunks(n);
+    vector<scan_state> states(n);
+    vector<thread> workers;
+    for(unsigned k = 0; k < n; k++)
+        workers.emplace_back([&, k] { states[k] = parse_csv_chunk(bounds[k], bounds[k + 1], chunks[k], opt.timescale); });
+    for(auto& w : workers)
+        w.join();
+
+    // records after the first early stop are not part of the input
+    auto stop = find_if(states.begin(), states.end(), [](scan_state s) { return s != scan_state::COMPLETE; });
+    if(stop != states.end() && *stop == scan_state::MALFORMED) [[unlikely]] {
+        cerr << fname << ": malformed line" << endl;
+        exit(-1);
+    }
+    if(stop != states.end())
+        chunks.resize(stop - states.begin() + 1);
+
+    // merge neighbouring chunks in parallel; ties go to the earlier chunk, as in a stable sort
+    while(chunks.size() > 1) {
+        vector<SORTED> merged((chunks.size() + 1) / 2);
+        workers.clear();
+        for(size_t k = 0; k + 1 < chunks.size(); k += 2)
+            workers.emplace_back([&, k] {
+                auto& l = chunks[k];
+                auto& r = chunks[k + 1];
+                merged[k / 2].resize(l.size() + r.size());
+                merge(l.begin(), l.end(), r.begin(), r.end(), merged[k / 2].begin(),
+                      [](const auto& lhs, const auto& rhs) { return get<1>(lhs) < get<1>(rhs); });
+                SORTED().swap(l);
+                SORTED().swap(r);
+            });
+        if(chunks.size() % 2 == 1)
+            merged.back() = move(chunks.back());
+        for(auto& w : workers)
+            w.join();
+        chunks.swap(merged);
+    }
+    SORTED result = move(chunks.front());
+
+    print_interval(result, opt.timescale);
     return result;
 }
 
-STREAM sum_by_flow(const SORTED& data) {
-    STREAM result;
-    for(auto& p : data) {
-        auto& q = result[get<0>(p)];
-        if(q.empty() || q.back().first < get<1>(p))
-            q.emplace_back(get<1>(p), get<2>(p));
+SORTED parse_binary(const string& fname, const trace_options& opt) {
+    mapped_file f(fname);
+    if(!f.is_open() || f.size() < sizeof(trace_header)) [[unlikely]]
+        exit(-1);
+
+    trace_header header;
+    memcpy(&header, f.begin(), sizeof(header));
+    if(!header.valid() || f.size() != header.file_size()) [[unlikely]] {
+        cerr << fname << ": malformed binary trace" << endl;
+        exit(-1);
+    }
+
+    auto column = [&](int k) { return reinterpret_cast<const uint32_t*>(f.begin() + sizeof(header)) + k * header.count; };
+    const uint32_t* id = column(0);
+    const uint32_t* len = column(1);
+    const uint32_t* time = column(3);
+    const uint16_t* delta = reinterpret_cast<const uint16_t*>(time);
+
+    SORTED result;
+    result.reserve(header.count);
+    uint32_t t = header.base_time;
+    for(uint64_t i = 0; i < header.count; i++) {
+        if(header.flags & trace_header::TIME_DELTA)
+            t += delta[i];
         else
-            q.back().second += get<2>(p);
+            t = time[i];
+        if(!push_packet(result, id[i], len[i], t, opt.timescale)) [[unlikely]]
+            break;
     }
+    if(!(header.flags & trace_header::TIME_ORDERED))
+        sort_by_time(result);
+
+    print_interval(result, opt.timescale);
     return result;
 }
 
-// align rhs to lhs: assume rhs only differs from lhs in DATA value
-void align(STREAM_QUEUE lhs, STREAM_QUEUE& rhs) {
-    transform(lhs.begin(), lhs.end(), lhs.begin(),
+SORTED parse_trace(const string& fname, const trace_options& opt) {
+    trace_header header{};
+    ifstream f(fname, ios_base::binary);
+    if(f.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.valid())
+        return parse_binary(fname, opt);
+    return parse_csv_simple(fname, opt);
+}
+
+size_t convert_csv_binary(const string& csv, const string& bin, bool delta) {
+    mapped_file f(csv);
+    if(!f.is_open()) [[unlikely]]
+        exit(-1);
+
+    vector<uint32_t> columns[4];
+    scan_state state = scan_csv(find(f.begin(), f.end(), '\n'), f.end(),
+                                [&](uint32_t id, uint32_t len, uint32_t time, uint32_t qlen) {
+        columns[0].push_back(id);
+        columns[1].push_back(len);
+        columns[2].push_back(qlen);
+        columns[3].push_back(time);
+        return true;
+    });
+    // a partial trace is not written
+    if(state != scan_state::COMPLETE) [[unlikely]] {
+        cerr << csv << ": malformed line after " << columns[0].size() << " records" << endl;
+        exit(-1);
+    }
+    auto& time = columns[3];
+
+    trace_header header{};
+    header.count = time.size();
+    if(is_sorted(time.begin(), time.end()))
+        header.flags |= trace_header::TIME_ORDERED;
+    if(!time.empty() && (header.flags & trace_header::TIME_ORDERED))
+        header.base_time = time.front();
+
+    vector<uint16_t> deltas;
+    if(delta && (header.flags & trace_header::TIME_ORDERED)) {
+        uint32_t last = header.base_time;
+        for(auto t : time) {
+            if(t - last > numeric_limits<uint16_t>::max())
+                break;
+            deltas.push_back(t - last);
+            last = t;
+        }
+        if(deltas.size() == time.size())
+            header.flags |= trace_header::TIME_DELTA;
+        else
+            cerr << "time gap exceeds 16 bits, timestamps are stored without delta encoding" << endl;
+    } else if(delta)
+        cerr << "trace is not time-ordered, timestamps are stored without delta encoding" << endl;
+
+    ofstream os(bin, ios_base::out | ios_base::binary | ios_base::trunc);
+    if(!os) [[unlikely]]
+        exit(-1);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(int k = 0; k < 3; k++)
+        os.write(reinterpret_cast<const char*>(columns[k].data()), columns[k].size() * sizeof(uint32_t));
+    if(header.flags & trace_header::TIME_DELTA)
+        os.write(reinterpret_cast<const char*>(deltas.data()), deltas.size() * sizeof(uint16_t));
+    else
+        os.write(reinterpret_cast<const char*>(time.data()), time.size() * sizeof(uint32_t));
+    if(!os) [[unlikely]]
+        exit(-1);
+
+    return header.count;
+}
+
+STREAM sum_by_flow(const SORTED& data) {
+    flow_builder result;
+    for(auto& p : data)
+        sum_by_flow(result, p);
+    return result.build();
+}
+void sum_by_flow(flow_builder& result, const PACKET& p) {
+    result.add(get<0>(p), get<1>(p), get<2>(p));
+}
+void span_by_flow(flow_builder& result, const PACKET& p) {
+    result.extend(get<0>(p), get<1>(p));
+}
+
+packet_reader::packet_reader(const string& fname, const trace_options& opt) : file(fname), timescale(opt.timescale) {
+    if(!file.is_open()) [[unlikely]]
+        exit(-1);
+
+    if(file.size() >= sizeof(header))
+        memcpy(&header, file.begin(), sizeof(header));
+    binary = header.valid();
+    if(binary) {
+        if(file.size() != header.file_size() || !(header.flags & trace_header::TIME_ORDERED)) [[unlikely]] {
+            cerr << fname << ": streaming requires a well-formed time-ordered trace" << endl;
+            exit(-1);
+        }
+        raw_time = header.base_time;
+    } else {
+        // ignore first line
+        pos = find(file.begin(), file.end(), '\n');
+    }
+    released = file.begin();
+}
+
+bool packet_reader::next(SORTED& batch, size_t n) {
+    batch.clear();
+    if(binary) {
+        auto column = [&](int k) { return reinterpret_cast<const uint32_t*>(file.begin() + sizeof(header)) + k * header.count; };
+        const uint32_t* id = column(0);
+        const uint32_t* len = column(1);
+        const uint32_t* time = column(3);
+        const uint16_t* delta = reinterpret_cast<const uint16_t*>(time);
+        for(; !done && batch.size() < n && index < header.count; index++) {
+            if(header.flags & trace_header::TIME_DELTA)
+                raw_time += delta[index];
+            else
+                raw_time = time[index];
+            done = !push_packet(batch, id[index], len[index], raw_time, timescale);
+        }
+        done |= index == header.count;
+        // give back consumed pages of every column
+        if(done || index - last_release >= RELEASE_SIZE / sizeof(uint32_t)) {
+            size_t time_width = header.flags & trace_header::TIME_DELTA ? sizeof(uint16_t) : sizeof(uint32_t);
+            for(int k = 0; k < 3; k++)
+                file.release(reinterpret_cast<const char*>(column(k)), reinterpret_cast<const char*>(column(k) + index));
+            file.release(reinterpret_cast<const char*>(time), reinterpret_cast<const char*>(time) + index * time_width);
+            last_release = index;
+        }
+    } else {
+        uint32_t v[4];
+        while(!done && batch.size() < n) {
+            int state = scan_line(pos, file.end(), v);
+            if(state < 0) [[unlikely]] {
+                cerr << "malformed line in streamed trace" << endl;
+                exit(-1);
+            }
+            done = state == 0 || !push_packet(batch, v[0], v[1], v[2], timescale);
+        }
+        if(done || pos - released >= RELEASE_SIZE) {
+            file.release(released, pos);
+            released = pos;
+        }
+    }
+
+    for(auto& p : batch) {
+        if(get<1>(p) < last_time) [[unlikely]] {
+            cerr << "streaming requires a time-ordered trace" << endl;
+            exit(-1);
+        }
+        last_time = get<1>(p);
+    }
+    return !batch.empty();
+}
+
+vector<const test_suite::entry*> test_suite::select(unsigned pass) const {
+    vector<const entry*> result;
+    for(auto& e : entries)
+        if(e.pass == pass)
+            result.push_back(&e);
+    return result;
+}
+
+template<typename F>
+vector<chrono::duration<double>> test_suite::transform(thread_pool& pool, const vector<const entry*>& models, F&& next) {
+    vector<chrono::duration<double>> time_diff(models.size());
+    vector<size_t> allocs(models.size());
+    vector<future<void>> jobs(models.size());
+    for(auto e : models)
+        e->model->reset();
+
+    // each model owns one job per batch; the batch is released once all jobs are done
+    span<const PACKET> batch;
+    while(next(batch)) {
+        for(size_t k = 0; k < models.size(); k++)
+            jobs[k] = pool.submit([&, k] {
+                auto start_time = chrono::high_resolution_clock::now();
+                auto model = models[k]->model.get();
+                size_t before = thread_allocs;
+                model->count_batch(batch);
+                allocs[k] += thread_allocs - before;
+                time_diff[k] += chrono::high_resolution_clock::now() - start_time;
+            });
+        for(auto& j : jobs)
+            j.get();
+    }
+    for(size_t k = 0; k < models.size(); k++)
+        jobs[k] = pool.submit([&, k] {
+            auto start_time = chrono::high_resolution_clock::now();
+            models[k]->model->flush();
+            time_diff[k] += chrono::high_resolution_clock::now() - start_time;
+        });
+    for(auto& j : jobs)
+        j.get();
+#ifdef COUNT_ALLOCS
+    for(size_t k = 0; k < models.size(); k++)
+        cerr << models[k]->method << "," << models[k]->memory << ": " << allocs[k] << " allocations while counting" << endl;
+    cerr << "history: " << history_stats::rings << " rings, " << history_stats::spills << " spills, "
+         << history_stats::growths << " spill growths, " << history_stats::thaws << " thaws" << endl;
+#endif
+    return time_diff;
+}
+
+void test_suite::evaluate(thread_pool& pool, const vector<const entry*>& models,
+                          const vector<chrono::duration<double>>& time_diff,
+                          const STREAM& dict, bool truth, ostream& os, ostream& fs, ostream& ms) {
+    // every model writes to private buffers, appended to the shared streams in registration order
+    vector<array<ostringstream, 3>> sinks(models.size());
+    vector<future<void>> jobs;
+    for(size_t k = 0; k < models.size(); k++)
+        jobs.push_back(pool.submit([&, k] {
+            auto e = models[k];
+            auto& [os_k, fs_k, ms_k] = sinks[k];
+            ms_k << e->method << "," << e->memory << "," << time_diff[k].count() << "," << e->model->serialize();
+            auto result = inverse_transform(*e->model, dict, ms_k, e->method);
+            flow_report(result, fs_k, e->method, e->memory);
+            if(truth) {
+                align(dict, result);
+                compare(dict, result, os_k, e->method, e->memory);
+            }
+            e->model->reset();
+        }));
+
+    for(size_t k = 0; k < models.size(); k++) {
+        jobs[k].get();
+        os << sinks[k][0].view();
+        fs << sinks[k][1].view();
+        ms << sinks[k][2].view();
+    }
+    os << flush;
+    fs << flush;
+    ms << flush;
+}
+
+void test_suite::add(unique_ptr<abstract_scheme> model, const methods method, const uint32_t memory, unsigned pass) {
+    entries.push_back({move(model), method, memory, pass});
+}
+
+void test_suite::run(const SORTED& input, const STREAM& dict, ostream& os, ostream& fs, ostream& ms) const {
+    set<unsigned> passes;
+    for(auto& e : entries)
+        passes.insert(e.pass);
+
+    thread_pool pool(threads);
+    for(auto pass : passes) {
+        auto models = select(pass);
+        size_t pos = 0;
+        auto time_diff = transform(pool, models, [&](span<const PACKET>& batch) {
+            size_t n = min<size_t>(BATCH_SIZE, input.size() - pos);
+            batch = span<const PACKET>(input).subspan(pos, n);
+            pos += n;
+            return n > 0;
+        });
+        evaluate(pool, models, time_diff, dict, true, os, fs, ms);
+    }
+}
+
+void test_suite::run(const string& fname, const trace_options& opt, STREAM& dict, bool truth,
+                     ostream& os, ostream& fs, ostream& ms) const {
+    set<unsigned> passes;
+    for(auto& e : entries)
+        passes.insert(e.pass);
+
+    thread_pool pool(threads);
+    for(auto pass : passes) {
+        auto models = select(pass);
+        bool collect = dict.empty();
+        flow_builder builder;
+        packet_reader reader(fname, opt);
+        SORTED buffer;
+        auto time_diff = transform(pool, models, [&](span<const PACKET>& batch) {
+            if(!reader.next(buffer))
+                return false;
+            if(collect)
+                for(auto& t : buffer) {
+                    if(truth)
+                        sum_by_flow(builder, t);
+                    else
+                        span_by_flow(builder, t);
+                }
+            batch = buffer;
+            return true;
+        });
+        if(collect)
+            dict = builder.build();
+        if(collect && truth)
+            flow_report(dict, fs, methods::REFERENCE);
+        evaluate(pool, models, time_diff, dict, truth, os, fs, ms);
+    }
+}
+
+void epoch_test(vector<unique_ptr<abstract_scheme>> buffers, const string& fname, const trace_options& opt,
+                TIME length, bool truth, ostream& os, ostream& fs, ostream& ms, const methods method,
+                const uint32_t memory) {
+    // flows of each epoch, published by the reader before the epoch is closed
+    mutex lock;
+    map<TIME, STREAM> dicts;
+    epoch_rotation rotation(move(buffers), [&](const epoch_rotation::epoch& e) {
+        STREAM dict;
+        {
+            lock_guard<mutex> guard(lock);
+            dict = move(dicts.extract(e.id).mapped());
+        }
+        ms << method << "," << memory << "," << e.transform_time.count() << "," << e.bytes.size();
+        auto result = inverse_transform(e.model, dict, ms, method);
+        flow_report(result, fs, method, memory);
+        if(truth) {
+            align(dict, result);
+            compare(dict, result, os, method, memory);
+        }
+    }, length);
+
+    flow_builder builder;
+    packet_reader reader(fname, opt);
+    SORTED buffer;
+    TIME id = 0;
+    bool open = false;
+    auto publish = [&] {
+        lock_guard<mutex> guard(lock);
+        dicts[id] = builder.build();
+    };
+    while(reader.next(buffer)) {
+        for(auto& p : buffer) {
+            if(open && get<1>(p) / length != id)
+                publish();
+            id = get<1>(p) / length;
+            open = true;
+            if(truth)
+                sum_by_flow(builder, p);
+            else
+                span_by_flow(builder, p);
+        }
+        rotation.count_batch(buffer);
+    }
+    if(open)
+        publish();
+    rotation.finish();
+}
+
+// align rhs to lhs into out: assume rhs only differs from lhs in DATA value
+void align(SERIES lhs, SERIES rhs, span<pair<TIME, DATA>> out) {
+    transform(lhs.begin(), lhs.end(), out.begin(),
               [](const auto& p){ return make_pair(p.first, 0); });
 
-    auto l_it = lhs.begin();
+    auto l_it = out.begin();
     auto r_it = rhs.begin();
-    while(l_it != lhs.end() && r_it != rhs.end()) {
+    while(l_it != out.end() && r_it != rhs.end()) {
         if(l_it->first < r_it->first)
             l_it++;
         else if(l_it->first > r_it->first)
@@ -118,24 +617,18 @@ void align(STREAM_QUEUE lhs, STREAM_QUEUE& rhs) {
             r_it++;
         }
     }
-
-    rhs.swap(lhs);
 }
 void align(const STREAM& lhs, STREAM& rhs) {
-    for(auto& p : lhs) {
-        auto& l_queue = p.second;
-        auto& r_queue = rhs[p.first];
-        align(l_queue, r_queue);
-    }
+    STREAM result;
+    result.reserve(lhs.size(), lhs.points());
+    for(auto [f, l_queue] : lhs)
+        align(l_queue, rhs.get(f), result.allocate(f, l_queue.size()));
+    rhs = move(result);
 }
 
-void flow_report(const STREAM& dict, ostream& fs, const methods m) {
-#ifdef FLOW_OUT
-    if(dict.contains(breakpoint)) [[likely]] {
-        for(auto &p : dict.at(breakpoint))
-            fs << m << "," << MEMORY << "," << p.first << "," << p.second << endl;
-    }
-#endif
+void flow_report(const STREAM& dict, ostream& fs, const methods m, const uint32_t memory) {
+    for(auto &p : dict.get(breakpoint))
+        fs << m << "," << memory << "," << p.first << "," << p.second << endl;
 }
 
 // demonstrates why we must use double in polygon solver
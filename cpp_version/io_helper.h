@@ -2,34 +2,96 @@
 #define IO_HELPER_H
 
 #include "Utility/headers.h"
+#include "Utility/mapped_file.h"
+#include "Utility/thread_pool.h"
 #include "benchmark.h"
 
 using namespace std;
 
+/* trace options known at runtime */
+struct trace_options {
+    // input time(ns) per time slot
+    uint32_t timescale = TIMESCALE;
+    // worker threads for parsing, 0 for hardware concurrency
+    unsigned threads = PARSE_THREADS;
+};
+
 /* csv parser */
 STREAM parse_csv_full(const string& fname);
-SORTED parse_csv_simple(const string& fname);
+SORTED parse_csv_simple(const string& fname, const trace_options& opt = {});
 STREAM sum_by_flow(const SORTED& data);
+// accumulate one packet into the per-flow ground truth
+void sum_by_flow(flow_builder& result, const PACKET& p);
+// keep only the first and the last timestamp of each flow, enough to query a scheme
+void span_by_flow(flow_builder& result, const PACKET& p);
+
+/* binary trace: header, then fid, byte and qlen columns, then time column */
+struct trace_header {
+    constexpr static const char signature[8] = {'N', 'I', 'F', 'T', 'R', 'A', 'C', 'E'};
+    constexpr static const uint32_t current = 1;
+    enum : uint32_t {
+        // timestamps are non-decreasing
+        TIME_ORDERED = 1u << 0,
+        // time column holds 16-bit gaps to the previous record, starting from base_time
+        TIME_DELTA = 1u << 1
+    };
+
+    char magic[8] = {'N', 'I', 'F', 'T', 'R', 'A', 'C', 'E'};
+    uint32_t version = current;
+    uint32_t flags = 0;
+    uint64_t count = 0;
+    uint32_t base_time = 0;
+    uint32_t reserved = 0;
+
+    bool valid() const {
+        return memcmp(magic, signature, sizeof(signature)) == 0 && version == current;
+    }
+    size_t file_size() const {
+        size_t time_width = flags & TIME_DELTA ? sizeof(uint16_t) : sizeof(uint32_t);
+        return sizeof(trace_header) + count * (3 * sizeof(uint32_t) + time_width);
+    }
+};
+static_assert(sizeof(trace_header) == 32);
+
+SORTED parse_binary(const string& fname, const trace_options& opt = {});
+// binary or csv trace, detected by signature
+SORTED parse_trace(const string& fname, const trace_options& opt = {});
+// return the number of converted records
+size_t convert_csv_binary(const string& csv, const string& bin, bool delta = false);
+
+/* streaming reader over a time-ordered csv or binary trace, with bounded resident memory */
+class packet_reader {
+protected:
+    // consumed bytes of the mapping given back at a time
+    constexpr static const size_t RELEASE_SIZE = 64u << 20;
+
+    mapped_file file;
+    trace_header header{};
+    bool binary = false;
+    bool done = false;
+    // csv cursor
+    const char* pos = nullptr;
+    const char* released = nullptr;
+    // binary cursor
+    uint64_t index = 0;
+    uint64_t last_release = 0;
+    uint32_t raw_time = 0;
+
+    uint32_t timescale;
+    TIME last_time = 0;
+public:
+    explicit packet_reader(const string& fname, const trace_options& opt = {});
+    // read at most n packets into batch, return false at the end of trace
+    bool next(SORTED& batch, size_t n = BATCH_SIZE);
+};
 
 /* deque alignment */
-void align(STREAM_QUEUE lhs, STREAM_QUEUE& rhs);
+void align(SERIES lhs, SERIES rhs, span<pair<TIME, DATA>> out);
 void align(const STREAM& lhs, STREAM& rhs);
 
 /* flow report */
-void flow_report(const STREAM& dict, ostream& fs, const methods m);
+void flow_report(const STREAM& dict, ostream& fs, const methods m, const uint32_t memory = MEMORY);
 
-template<DerivedScheme S>
-inline void forward_transform(S& model, const SORTED& data, ostream& ms, const methods method) {
-    auto start_time = chrono::high_resolution_clock::now();
-
-    for(auto& t : data)
-        model.count(get<0>(t), get<1>(t), get<2>(t));
-    model.flush();
-
-    auto end_time = chrono::high_resolution_clock::now();
-    chrono::duration<double> time_diff = end_time - start_time;
-    ms << method << "," << MEMORY << "," << time_diff.count() << "," << model.serialize();
-}
 template<DerivedScheme S>
 inline STREAM inverse_transform(S& model, const STREAM& dict, ostream& ms, const methods method) {
     auto start_time = chrono::high_resolution_clock::now();
@@ -42,18 +104,44 @@ inline STREAM inverse_transform(S& model, const STREAM& dict, ostream& ms, const
 
     return result;
 }
-template<DerivedScheme S>
-void test(S& model, const SORTED& input, const STREAM& dict, ostream& os, ostream& fs, ostream& ms, const methods method) {
-    model.reset();
-    forward_transform(model, input, ms, method);
-    auto result = inverse_transform(model, dict, ms, method);
 
-    flow_report(result, fs, method);
+/* fan-out driver: each pass reads the input once and feeds every scheme registered to it,
+ * schemes are counted and evaluated on a pool of threads */
+class test_suite {
+protected:
+    struct entry {
+        unique_ptr<abstract_scheme> model;
+        methods method;
+        uint32_t memory;
+        unsigned pass;
+    };
+    vector<entry> entries;
+    unsigned threads;
 
-    align(dict, result);
-    compare(dict, result, os, method);
-    model.reset();
-}
+    vector<const entry*> select(unsigned pass) const;
+    // count batches from next(batch) into every model of the pass, return the time spent per model
+    template<typename F>
+    static vector<chrono::duration<double>> transform(thread_pool& pool, const vector<const entry*>& models, F&& next);
+    // rebuild and report every model of the pass concurrently
+    static void evaluate(thread_pool& pool, const vector<const entry*>& models,
+                         const vector<chrono::duration<double>>& time_diff,
+                         const STREAM& dict, bool truth, ostream& os, ostream& fs, ostream& ms);
+public:
+    explicit test_suite(unsigned threads = EVAL_THREADS) : threads(threads) {}
+
+    // schemes of a later pass are counted only after all schemes of earlier passes are rebuilt
+    void add(unique_ptr<abstract_scheme> model, const methods method, const uint32_t memory = MEMORY, unsigned pass = 0);
+    void run(const SORTED& input, const STREAM& dict, ostream& os, ostream& fs, ostream& ms) const;
+    // stream the trace; dict is filled by the first pass when empty, and holds the ground truth if truth is set
+    void run(const string& fname, const trace_options& opt, STREAM& dict, bool truth,
+             ostream& os, ostream& fs, ostream& ms) const;
+};
+
+/* continuous driver: stream the trace through a rotation of sketches of one scheme; every epoch of length
+ * time slots is rebuilt on the flows seen in it, in the background while later epochs are counted */
+void epoch_test(vector<unique_ptr<abstract_scheme>> buffers, const string& fname, const trace_options& opt,
+                TIME length, bool truth, ostream& os, ostream& fs, ostream& ms, const methods method,
+                const uint32_t memory = MEMORY);
 
 
 #endif //IO_HELPER_H
@@ -2,92 +2,121 @@
 #include "Utility/headers.h"
 #include "io_helper.h"
 #include "benchmark.h"
+#include "config.h"
 
-#include "OmniWindow/omniwindow.h"
-#include "Fourier/fourier.h"
-#include "PersistCMS/persistCMS.h"
-#include "PersistAMS/persistAMS.h"
-#include "Wavelet/wavelet.h"
-#include "NaiveCMS/naiveCMS.h"
-#include "WaveletAlt/wavelet_alt.h"
+#include "schemes.h"
 
 using namespace std;
 
-int main() {
-    auto start_time = chrono::high_resolution_clock::now();
-    auto input = parse_csv_simple(FILE_IN);
-    auto parse_time = chrono::high_resolution_clock::now();
-    chrono::duration<double> parse_diff = parse_time - start_time;
-    cerr << "parse time: " << parse_diff.count() << "s" << endl;
-
-    auto dict = sum_by_flow(input);
-
-#ifdef FILE_OUT
-    ofstream os(FILE_OUT, ios_base::out | ios_base::app);
-    if(!os) [[unlikely]]
-        exit(-1);
-    if(os.tellp() == 0)
-        os << benchmark::format << endl;
-#else
-    ostream& os = cout;
-#endif
-#ifdef FLOW_OUT
-    ofstream fs(FLOW_OUT, ios_base::out);
-    if(!fs) [[unlikely]]
-        exit(-1);
-    if(fs.tellp() == 0) {
-        fs << "class,memory,time,data" << endl;
-        flow_report(dict, fs, methods::REFERENCE);
-    }
-#else
-    ostream& fs = cout;
-#endif
-#ifdef META_OUT
-    ofstream ms(META_OUT, ios_base::out | ios_base::app);
-    if(!ms) [[unlikely]]
-        exit(-1);
-    if(ms.tellp() == 0)
-        ms << "class,memory,transform-time,size,rebuild-time" << endl;
-#else
-    ostream& ms = cerr;
-#endif
-
-#ifdef USE_NAIVE_CMS
-    static naiveCMS scheme1{};
-    test(scheme1, input, dict, os, fs, ms, USE_NAIVE_CMS);
-#endif
-#ifdef USE_OMNIWINDOW
-    static omniwindow scheme2{};
-    test(scheme2, input, dict, os, fs, ms, USE_OMNIWINDOW);
-#endif
-#ifdef USE_FOURIER
-    static fourier scheme3{};
-    test(scheme3, input, dict, os, fs, ms, USE_FOURIER);
-#endif
-#ifdef USE_PERSIST_CMS
-    static persistCMS scheme4{};
-    test(scheme4, input, dict, os, fs, ms, USE_PERSIST_CMS);
-#endif
-#ifdef USE_PERSIST_AMS
-    static persistAMS scheme5{};
-    test(scheme5, input, dict, os, fs, ms, USE_PERSIST_AMS);
-#endif
-#ifdef USE_WAVE_IDEAL
-    static wavelet<false> scheme6{};
-    test(scheme6, input, dict, os, fs, ms, USE_WAVE_IDEAL);
-#endif
-#ifdef USE_WAVE_PRACTICAL
-    static wavelet<true> scheme7{};
-    test(scheme7, input, dict, os, fs, ms, USE_WAVE_PRACTICAL);
-#endif
+template<uint32_t W>
+void add_width(test_suite& suite, const config& cfg, unsigned index) {
+    constexpr uint32_t memory = MEMORY_OF(W);
+    if(!cfg.use(memory))
+        return;
+    for(methods m : {methods::NAIVE_CMS, methods::OMNIWINDOW, methods::FOURIER,
+                     methods::PERSIST_CMS, methods::PERSIST_AMS})
+        if(cfg.use(m))
+            suite.add(make_scheme<W>(m), m, memory);
+    // thresholds of wavelet<true> are calibrated by the rebuild of wavelet<false> and shared by all widths;
+    // the practical scheme of one width is counted beside the ideal scheme of the next width,
+    // whose thresholds are set only after that pass is counted
+    if(cfg.use(methods::WAVE_IDEAL))
+        suite.add(make_scheme<W>(methods::WAVE_IDEAL, cfg.sharded), methods::WAVE_IDEAL, memory, index);
+    if(cfg.use(methods::WAVE_PRACTICAL))
+        suite.add(make_scheme<W>(methods::WAVE_PRACTICAL, cfg.sharded), methods::WAVE_PRACTICAL, memory, index + 1);
 #ifdef USE_WAVE_ALT_I
-    static wavelet_alt<1> scheme8{};
-    test(scheme8, input, dict, os, fs, ms, USE_WAVE_ALT_I);
+    suite.add(make_scheme<W>(USE_WAVE_ALT_I), USE_WAVE_ALT_I, memory);
 #endif
 #ifdef USE_WAVE_ALT_P
-    static wavelet_alt<2> scheme9{};
-    test(scheme9, input, dict, os, fs, ms, USE_WAVE_ALT_P);
+    suite.add(make_scheme<W>(USE_WAVE_ALT_P), USE_WAVE_ALT_P, memory);
 #endif
+}
+
+// sweep the selected widths on one parsed trace; passes are numbered over selected widths only
+template<uint32_t... Ws>
+void add_schemes(test_suite& suite, const config& cfg) {
+    unsigned index = 0;
+    ((add_width<Ws>(suite, cfg, index), index += cfg.use(MEMORY_OF(Ws))), ...);
+}
+
+// each selected scheme streams the trace on its own, through a rotation of epoch_buffers sketches
+template<uint32_t W>
+void run_epochs(const config& cfg, const trace_options& opt, ostream& os, ostream& fs, ostream& ms) {
+    constexpr uint32_t memory = MEMORY_OF(W);
+    if(!cfg.use(memory))
+        return;
+    for(methods m : cfg.schemes) {
+        vector<unique_ptr<abstract_scheme>> buffers;
+        for(unsigned k = 0; k < cfg.epoch_buffers; k++)
+            buffers.push_back(make_scheme<W>(m, cfg.sharded));
+        if(buffers.front() == nullptr)
+            continue;
+        epoch_test(move(buffers), cfg.input, opt, cfg.epoch, cfg.truth, os, fs, ms, m, memory);
+    }
+}
+
+template<uint32_t... Ws>
+void run_all_epochs(const config& cfg, const trace_options& opt, ostream& os, ostream& fs, ostream& ms) {
+    (run_epochs<Ws>(cfg, opt, os, fs, ms), ...);
+}
+
+int main(int argc, char* argv[]) {
+    auto cfg = config::parse(argc, argv);
+    trace_options opt{cfg.timescale, cfg.parse_threads};
+    rebuild_threads = cfg.rebuild_threads;
+
+    STREAM dict;
+    SORTED input;
+    if(!cfg.stream && cfg.epoch == 0) {
+        auto start_time = chrono::high_resolution_clock::now();
+        input = parse_trace(cfg.input, opt);
+        auto parse_time = chrono::high_resolution_clock::now();
+        chrono::duration<double> parse_diff = parse_time - start_time;
+        cerr << "parse time: " << parse_diff.count() << "s" << endl;
+
+        dict = sum_by_flow(input);
+    }
+
+    ofstream report_file, flow_file, meta_file;
+    ostream null_stream(nullptr);
+    if(!cfg.report.empty()) {
+        report_file.open(cfg.report, ios_base::out | ios_base::app);
+        if(!report_file) [[unlikely]]
+            exit(-1);
+        if(report_file.tellp() == 0)
+            report_file << benchmark::format << endl;
+    }
+    if(!cfg.flow.empty()) {
+        flow_file.open(cfg.flow, ios_base::out);
+        if(!flow_file) [[unlikely]]
+            exit(-1);
+        flow_file << "class,memory,time,data" << endl;
+        if(!cfg.stream && cfg.epoch == 0)
+            flow_report(dict, flow_file, methods::REFERENCE);
+    }
+    if(!cfg.meta.empty()) {
+        meta_file.open(cfg.meta, ios_base::out | ios_base::app);
+        if(!meta_file) [[unlikely]]
+            exit(-1);
+        if(meta_file.tellp() == 0)
+            meta_file << "class,memory,transform-time,size,rebuild-time" << endl;
+    }
+    ostream& os = cfg.report.empty() ? cout : report_file;
+    ostream& fs = cfg.flow.empty() ? null_stream : flow_file;
+    ostream& ms = cfg.meta.empty() ? cerr : meta_file;
+
+    if(cfg.epoch > 0) {
+        run_all_epochs<SWEEP_WIDTHS>(cfg, opt, os, fs, ms);
+        return 0;
+    }
+
+    // all schemes of a pass share one read of the input
+    test_suite suite(cfg.eval_threads);
+    add_schemes<SWEEP_WIDTHS>(suite, cfg);
+    if(cfg.stream)
+        suite.run(cfg.input, opt, dict, cfg.truth, os, fs, ms);
+    else
+        suite.run(input, dict, os, fs, ms);
 
     return 0;
 }
@@ -0,0 +1,53 @@
+#ifndef SCHEMES_H
+#define SCHEMES_H
+
+#include "Utility/headers.h"
+#include "benchmark.h"
+
+#include "OmniWindow/omniwindow.h"
+#include "Fourier/fourier.h"
+#include "PersistCMS/persistCMS.h"
+#include "PersistAMS/persistAMS.h"
+#include "Wavelet/wavelet.h"
+#include "NaiveCMS/naiveCMS.h"
+#include "WaveletAlt/wavelet_alt.h"
+#include "Utility/sharded.h"
+
+using namespace std;
+
+// the scheme of method m at width W, nullptr if there is none; wavelet schemes split W over SHARDS if sharded
+template<uint32_t W>
+unique_ptr<abstract_scheme> make_scheme(methods m, bool shard = false) {
+    switch(m) {
+        case methods::NAIVE_CMS:
+            return make_unique<naiveCMS<W>>();
+        case methods::OMNIWINDOW:
+            return make_unique<omniwindow<W>>();
+        case methods::FOURIER:
+            return make_unique<fourier<W>>();
+        case methods::PERSIST_CMS:
+            return make_unique<persistCMS<W>>();
+        case methods::PERSIST_AMS:
+            return make_unique<persistAMS<W>>();
+        case methods::WAVE_IDEAL:
+            if(shard)
+                return make_unique<sharded<wavelet<false, W / SHARDS>>>();
+            return make_unique<wavelet<false, W>>();
+        case methods::WAVE_PRACTICAL:
+            if(shard)
+                return make_unique<sharded<wavelet<true, W / SHARDS>>>();
+            return make_unique<wavelet<true, W>>();
+#ifdef USE_WAVE_ALT_I
+        case methods::WAVE_ALT_I:
+            return make_unique<wavelet_alt<1, W>>();
+#endif
+#ifdef USE_WAVE_ALT_P
+        case methods::WAVE_ALT_P:
+            return make_unique<wavelet_alt<2, W>>();
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+#endif //SCHEMES_H
@@ -0,0 +1,213 @@
+//
+// Checks run by ctest, one per argument: niffler_test <name>
+//
+
+#include <iostream>
+#include "io_helper.h"
+#include "schemes.h"
+
+using namespace std;
+
+// a time-ordered trace of heavy-tailed flows over a few windows, the breakpoint flow among them
+static SORTED synthetic_trace(size_t packets = 60000, uint32_t seed = 1) {
+    minstd_rand gen(seed);
+    SORTED result;
+    result.reserve(packets);
+    TIME t = 1;
+    for(size_t i = 0; i < packets; i++) {
+        t += gen() % 4 == 0;
+        uint32_t id = gen() % 20 == 0 ? breakpoint.dst_ip : uint32_t(500. / (1 + gen() % 500)) + gen() % 3 * 1000;
+        result.emplace_back(five_tuple(id), t, 1);
+    }
+    return result;
+}
+
+// reports of every scheme at a few widths, counted and evaluated on threads pool threads
+static string report(const SORTED& input, const STREAM& dict, unsigned threads, bool shard) {
+    test_suite suite(threads);
+    unsigned index = 0;
+    auto add = [&]<uint32_t W>() {
+        for(methods m : {methods::NAIVE_CMS, methods::OMNIWINDOW, methods::FOURIER,
+                         methods::PERSIST_CMS, methods::PERSIST_AMS})
+            suite.add(make_scheme<W>(m), m, MEMORY_OF(W));
+        // as in main, wavelet thresholds are calibrated by one width at a time
+        suite.add(make_scheme<W>(methods::WAVE_IDEAL, shard), methods::WAVE_IDEAL, MEMORY_OF(W), index);
+        suite.add(make_scheme<W>(methods::WAVE_PRACTICAL, shard), methods::WAVE_PRACTICAL, MEMORY_OF(W), index + 1);
+        index++;
+    };
+    add.template operator()<8>();
+    add.template operator()<16>();
+    add.template operator()<32>();
+
+    ostringstream os, fs, ms;
+    suite.run(input, dict, os, fs, ms);
+    return os.str() + fs.str();
+}
+
+// schemes report the same whether they are counted on one thread or side by side on several
+static bool test_threads() {
+    auto input = synthetic_trace();
+    auto dict = sum_by_flow(input);
+    for(bool shard : {false, true}) {
+        string serial = report(input, dict, 1, shard);
+        for(int run = 0; run < 2; run++)
+            if(report(input, dict, 4, shard) != serial) {
+                cerr << "threaded report differs from the serial one" << (shard ? ", sharded" : "") << endl;
+                return false;
+            }
+    }
+    return true;
+}
+
+// merging sketches whose windows of a flow cover each other's active slots gives what one sketch counting both would;
+// blocks of equal counts keep every detail exact
+static bool test_merge() {
+    const five_tuple f(7);
+    wavelet<true, 16> lhs, rhs, both;
+    SORTED packets;
+    for(TIME t = 100; t < 164; t++) {
+        // the window of lhs spans the slots of rhs, and neither records [116, 124) or [140, 148)
+        bool left = t < 116 || t >= 148, right = t >= 124 && t < 140;
+        if(!left && !right)
+            continue;
+        (left ? lhs : rhs).count(f, t, 4);
+        both.count(f, t, 4);
+        packets.emplace_back(f, t, 4);
+    }
+    lhs.flush();
+    rhs.flush();
+    both.flush();
+    lhs.merge(rhs);
+
+    auto dict = sum_by_flow(packets);
+    auto merged = lhs.rebuild(dict), expected = both.rebuild(dict);
+    if(!ranges::equal(merged.get(f), expected.get(f))) {
+        cerr << "merged series differs from the series counted at once" << endl;
+        return false;
+    }
+    return true;
+}
+
+// the sketches of a rotation count and close epochs side by side, and report the same run after run
+static bool test_epochs() {
+    string fname = "niffler_test_epochs.csv";
+    {
+        ofstream os(fname);
+        os << "fid,byte,time_ns,qlen" << endl;
+        for(auto& [f, t, c] : synthetic_trace())
+            os << f.dst_ip << "," << c << "," << (t - 1) * TIMESCALE << ",0" << endl;
+    }
+    bool result = true;
+    for(methods m : {methods::PERSIST_AMS, methods::WAVE_PRACTICAL}) {
+        string first;
+        for(int run = 0; run < 3 && result; run++) {
+            vector<unique_ptr<abstract_scheme>> buffers;
+            for(unsigned k = 0; k < EPOCH_BUFFERS; k++)
+                buffers.push_back(make_scheme<16>(m));
+            ostringstream os, fs, ms;
+            epoch_test(move(buffers), fname, {}, MAX_LENGTH / 4, true, os, fs, ms, m, MEMORY_OF(16));
+            if(run == 0)
+                first = os.str() + fs.str();
+            else if(os.str() + fs.str() != first) {
+                cerr << m << ": epoch reports differ between runs" << endl;
+                result = false;
+            }
+        }
+    }
+    remove(fname.c_str());
+    return result;
+}
+
+// queries of a flushed wavelet sketch run side by side give what they give one by one
+static bool test_queries() {
+    auto input = synthetic_trace();
+    auto dict = sum_by_flow(input);
+    wavelet<true, 16> model;
+    model.count_batch(input);
+    model.flush();
+
+    auto answer = [&](const five_tuple& f, SERIES q) {
+        TIME a = q.front().first, b = q.back().first;
+        return make_tuple(model.query_point(f, (a + b) / 2), model.query_sum(f, a, b), model.query_max(f, a, b));
+    };
+    // the threads go first, while nothing has been read yet
+    vector<vector<tuple<DATA, int64_t, DATA>>> threaded(4);
+    vector<thread> workers;
+    for(auto& out : threaded)
+        workers.emplace_back([&] {
+            for(auto [f, q] : dict)
+                out.push_back(answer(f, q));
+        });
+    for(auto& w : workers)
+        w.join();
+
+    vector<tuple<DATA, int64_t, DATA>> serial;
+    for(auto [f, q] : dict)
+        serial.push_back(answer(f, q));
+    for(auto& out : threaded)
+        if(out != serial) {
+            cerr << "concurrent queries differ from serial ones" << endl;
+            return false;
+        }
+    return true;
+}
+
+#if HISTORY_RETENTION > 0
+// a heavy part recording whole windows of chosen flows into its only column
+class heavy_probe : public Wavelet::heavy<true, 1> {
+public:
+    void record(const five_tuple& f, TIME start, TIME length, DATA c) {
+        label[0][0] = f;
+        for(TIME t = start; t < start + length; t++)
+            counters[0][0].count(t, 0, c);
+        save_counter(0, 0);
+    }
+};
+
+// windows dropped by the history take their labels with them, so the windows kept are rebuilt for their own flows
+static bool test_retention() {
+    constexpr TIME length = 16;
+    constexpr uint32_t flows = 12;
+    heavy_probe h;
+    h.reset();
+    for(uint32_t k = 0; k < flows; k++)
+        h.record(five_tuple(k + 1), 1 + k * MAX_LENGTH, length, k + 1);
+    h.flush();
+
+    uint32_t kept = 0;
+    for(uint32_t k = 0; k < flows; k++) {
+        vector<pair<TIME, DATA>> out;
+        h.rebuild(five_tuple(k + 1), out);
+        kept += !out.empty();
+        TIME start = 1 + k * MAX_LENGTH;
+        for(auto& [t, v] : out)
+            if(t < start || t >= start + length || v != DATA(k + 1)) {
+                cerr << "window at " << t << " is rebuilt for flow " << k + 1 << endl;
+                return false;
+            }
+    }
+    if(kept == 0 || kept == flows) {
+        cerr << kept << " of " << flows << " windows kept" << endl;
+        return false;
+    }
+    return true;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    const map<string, bool (*)()> tests = {
+        {"threads", test_threads},
+        {"merge", test_merge},
+        {"epochs", test_epochs},
+        {"queries", test_queries},
+#if HISTORY_RETENTION > 0
+        {"retention", test_retention},
+#endif
+    };
+    if(argc != 2 || !tests.contains(argv[1])) {
+        cerr << "usage: " << argv[0] << " <test>" << endl;
+        return -1;
+    }
+    rebuild_threads = 2;
+    return tests.at(argv[1])() ? 0 : 1;
+}